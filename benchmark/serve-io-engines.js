@@ -0,0 +1,156 @@
+// 对比 mini_next_serve 的 epoll 与 io_uring 引擎：同一份静态目录、
+// 同样的并发与时长，输出吞吐与延迟分位数。
+//
+//   node benchmark/serve-io-engines.js [--connections 64] [--duration 5]
+//                                      [--threads 2] [--path /small.txt]
+const childProcess = require('child_process');
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+
+function parseArgs(argv) {
+  const opts = { connections: 64, duration: 5, threads: 2, path: null, port: 3917 };
+  for (let i = 0; i < argv.length; i++) {
+    const a = argv[i];
+    const next = argv[i + 1];
+    if (a === '--connections' && next) opts.connections = Number(next), i++;
+    else if (a === '--duration' && next) opts.duration = Number(next), i++;
+    else if (a === '--threads' && next) opts.threads = Number(next), i++;
+    else if (a === '--path' && next) opts.path = next, i++;
+    else if (a === '--port' && next) opts.port = Number(next), i++;
+  }
+  return opts;
+}
+
+function makeSite() {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'mini-next-bench-'));
+  fs.writeFileSync(path.join(dir, 'index.html'), '<!doctype html><div id="root"></div>');
+  fs.writeFileSync(path.join(dir, 'small.txt'), 'x'.repeat(2048));
+  fs.writeFileSync(path.join(dir, 'large.bin'), Buffer.alloc(1024 * 1024, 7));
+  return dir;
+}
+
+function startServer(binPath, dir, opts, engine) {
+  return new Promise((resolve, reject) => {
+    const child = childProcess.spawn(binPath, [
+      '--dir', dir,
+      '--port', String(opts.port),
+      '--threads', String(opts.threads),
+      '--io-engine', engine,
+    ]);
+    let out = '';
+    child.stderr.on('data', (d) => process.stderr.write(d));
+    child.stdout.on('data', (d) => {
+      out += d.toString();
+      if (out.includes('cache:')) {
+        const m = out.match(/io engine: (\S+)/);
+        resolve({ child, engine: m ? m[1] : engine });
+      }
+    });
+    child.on('exit', (code) => reject(new Error(`server exited with ${code}`)));
+  });
+}
+
+// 每个连接串行发请求（keep-alive），按 content-length 判断响应结束
+function runConnection(opts, reqPath, deadline, latencies) {
+  return new Promise((resolve) => {
+    const request = Buffer.from(`GET ${reqPath} HTTP/1.1\r\nHost: localhost\r\n\r\n`);
+    const sock = net.connect(opts.port, '127.0.0.1');
+    let buf = Buffer.alloc(0);
+    let start = 0n;
+    let errors = 0;
+    const send = () => {
+      if (Date.now() >= deadline) {
+        sock.end();
+        return;
+      }
+      start = process.hrtime.bigint();
+      sock.write(request);
+    };
+    sock.setNoDelay(true);
+    sock.on('connect', send);
+    sock.on('data', (d) => {
+      buf = buf.length ? Buffer.concat([buf, d]) : d;
+      while (true) {
+        const headEnd = buf.indexOf('\r\n\r\n');
+        if (headEnd < 0) return;
+        const m = /content-length: (\d+)/i.exec(buf.subarray(0, headEnd).toString());
+        const total = headEnd + 4 + (m ? Number(m[1]) : 0);
+        if (buf.length < total) return;
+        buf = buf.subarray(total);
+        latencies.push(Number(process.hrtime.bigint() - start) / 1e3);
+        send();
+      }
+    });
+    sock.on('error', () => {
+      errors++;
+    });
+    sock.on('close', () => resolve(errors));
+  });
+}
+
+function percentile(sorted, p) {
+  if (!sorted.length) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.floor((p / 100) * sorted.length))];
+}
+
+async function benchEngine(binPath, dir, opts, engine, reqPath) {
+  const server = await startServer(binPath, dir, opts, engine);
+  const latencies = [];
+  const deadline = Date.now() + opts.duration * 1000;
+  const started = Date.now();
+  const errors = await Promise.all(
+    Array.from({ length: opts.connections }, () => runConnection(opts, reqPath, deadline, latencies)),
+  );
+  const elapsed = (Date.now() - started) / 1000;
+  server.child.removeAllListeners('exit');
+  server.child.kill('SIGTERM');
+  await new Promise((r) => server.child.on('exit', r));
+  latencies.sort((a, b) => a - b);
+  return {
+    engine: server.engine,
+    path: reqPath,
+    rps: Math.round(latencies.length / elapsed),
+    p50: percentile(latencies, 50).toFixed(0),
+    p99: percentile(latencies, 99).toFixed(0),
+    max: (latencies[latencies.length - 1] || 0).toFixed(0),
+    errors: errors.reduce((a, b) => a + b, 0),
+  };
+}
+
+async function main() {
+  const opts = parseArgs(process.argv.slice(2));
+  const binPath = path.join(__dirname, '..', 'build', 'Release', 'mini_next_serve');
+  if (!fs.existsSync(binPath)) {
+    console.error(`missing ${binPath}, run npm run build:cpp first`);
+    process.exit(1);
+  }
+  const dir = makeSite();
+  try {
+    const paths = opts.path ? [opts.path] : ['/small.txt', '/large.bin'];
+    const rows = [];
+    for (const reqPath of paths) {
+      for (const engine of ['epoll', 'io_uring']) {
+        rows.push(await benchEngine(binPath, dir, opts, engine, reqPath));
+      }
+    }
+    console.log(`connections=${opts.connections} duration=${opts.duration}s threads=${opts.threads}`);
+    console.table(rows.map((r) => ({
+      engine: r.engine,
+      path: r.path,
+      'req/s': r.rps,
+      'p50 (us)': r.p50,
+      'p99 (us)': r.p99,
+      'max (us)': r.max,
+      errors: r.errors,
+    })));
+  } finally {
+    fs.rmSync(dir, { recursive: true, force: true });
+  }
+}
+
+main().catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
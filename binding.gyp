@@ -5,6 +5,8 @@
       "sources": [
         "src/node/addon.cpp",
         "src/cpp/router/route_matcher.cpp",
+        "src/cpp/router/route_manifest.cpp",
+        "src/cpp/router/route_rules.cpp",
         "src/cpp/renderer/react_renderer.cpp",
         "src/cpp/renderer/template_engine.cpp",
         "src/cpp/parser/markdown_parser.cpp",
@@ -127,6 +129,23 @@
       "sources": [
         "src/cpp/prod_server/mini_next_serve.cpp"
       ],
+      "libraries": [
+        "-lz"
+      ],
+      "cflags_cc": [
+        "-std=c++17",
+        "-O3",
+        "-Wall",
+        "-Wextra",
+        "-Wpedantic"
+      ]
+    },
+    {
+      "target_name": "mini_next_bench",
+      "type": "executable",
+      "sources": [
+        "src/cpp/prod_server/mini_next_bench.cpp"
+      ],
       "cflags_cc": [
         "-std=c++17",
         "-O3",
@@ -31,6 +31,16 @@ install -m 0600 "${CERT_KEY}" "/etc/nginx/cert/${DOMAIN}.key"
 
 CONF_PATH="/etc/nginx/sites-available/${NGINX_CONF_NAME}.conf"
 cat > "${CONF_PATH}" <<EOF
+map \$http_upgrade \$${NGINX_CONF_NAME}_connection {
+  default upgrade;
+  ''      '';
+}
+
+upstream ${NGINX_CONF_NAME}_upstream {
+  server ${UPSTREAM_HOST}:${UPSTREAM_PORT};
+  keepalive 64;
+}
+
 server {
   listen 80;
   server_name ${DOMAIN} ${DOMAIN#www.};
@@ -57,7 +67,7 @@ server {
   client_max_body_size 10m;
 
   location / {
-    proxy_pass http://${UPSTREAM_HOST}:${UPSTREAM_PORT};
+    proxy_pass http://${NGINX_CONF_NAME}_upstream;
 
     proxy_http_version 1.1;
     proxy_set_header Host \$host;
@@ -66,7 +76,7 @@ server {
     proxy_set_header X-Forwarded-Proto \$scheme;
 
     proxy_set_header Upgrade \$http_upgrade;
-    proxy_set_header Connection "upgrade";
+    proxy_set_header Connection \$${NGINX_CONF_NAME}_connection;
 
     proxy_read_timeout 60s;
     proxy_send_timeout 60s;
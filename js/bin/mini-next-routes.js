@@ -0,0 +1,31 @@
+#!/usr/bin/env node
+const path = require('path');
+const { buildRouteManifest } = require('../server');
+
+function parseArgs(argv) {
+  const out = {};
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i];
+    if (arg === '--pages' || arg === '--pages-dir') {
+      out.pagesDir = path.resolve(argv[++i]);
+    } else if (arg === '--out' || arg === '-o') {
+      out.outFile = path.resolve(argv[++i]);
+    } else if (arg === '--help' || arg === '-h') {
+      out.help = true;
+    }
+  }
+  return out;
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  if (args.help) {
+    console.log('Usage: mini-next-routes [--pages <dir>] [--out <file>]');
+    console.log('Default: --pages ./pages --out ./.mini-next/routes.bin');
+    return;
+  }
+  const { pagesDir, outFile } = buildRouteManifest(args);
+  console.log(`route manifest written: ${outFile} (pagesDir: ${pagesDir})`);
+}
+
+main();
@@ -1,4 +1,4 @@
-const { createMiniNextServer, startMiniNextDevServer } = require('./server');
+const { createMiniNextServer, startMiniNextDevServer, buildRouteManifest } = require('./server');
 const { renderDocument, renderPage } = require('./renderer');
 const { getInitialPageData } = require('./client');
 const { css, runWithStyleRegistry } = require('./css');
@@ -7,6 +7,7 @@ const { createMiniNextEdgeHandler } = require('./edge');
 module.exports = {
   createMiniNextServer,
   startMiniNextDevServer,
+  buildRouteManifest,
   renderDocument,
   renderPage,
   getInitialPageData,
@@ -36,6 +36,75 @@ function pickRenderer(native, options = {}) {
   };
 }
 
+const NO_ROUTE_MATCH = Object.freeze({ matched: false, filePath: '', params: {} });
+const NO_RULE_HEADERS = Object.freeze([]);
+
+// 路由快路径：native 只返回路由 id 和参数区间（写进复用的 Uint32Array），
+// 路由描述按 id 缓存在 JS 侧，params 首次访问时才从 url 切出来。
+// resolve 额外应用 redirect/rewrite/header 规则，与页面匹配在一次调用里完成
+function createRouteLookup(routeMatcher) {
+  if (typeof routeMatcher.matchInto !== 'function') {
+    const match = (urlPath) => routeMatcher.match(urlPath);
+    const resolve = (urlPath) => ({ urlPath, headers: NO_RULE_HEADERS, redirect: null, match: match(urlPath) });
+    return { match, resolve };
+  }
+  const spans = new Uint32Array(1 + 2 * 32);
+  const routesById = new Map();
+
+  const buildParams = (urlPath, route, offsets) => {
+    const params = {};
+    for (let i = 0; i < route.paramNames.length; i++) {
+      const begin = offsets[1 + 2 * i];
+      if (begin !== 0xffffffff) {
+        params[route.paramNames[i]] = urlPath.slice(begin, offsets[2 + 2 * i]);
+      } else if (route.paramKinds[i] === 'optional') {
+        params[route.paramNames[i]] = undefined;
+      }
+    }
+    return params;
+  };
+
+  const fromSpans = (id, urlPath) => {
+    if (id === 0) return NO_ROUTE_MATCH;
+    let route = routesById.get(id);
+    if (!route) {
+      route = routeMatcher.matchRouteInfo(urlPath, spans);
+      if (!route) return NO_ROUTE_MATCH;
+      routesById.set(route.id, route);
+    }
+    if (1 + 2 * spans[0] > spans.length) return routeMatcher.match(urlPath);
+    const offsets = route.paramNames.length > 0 ? spans.slice(0, 1 + 2 * spans[0]) : null;
+    let params = null;
+    return {
+      matched: true,
+      filePath: route.filePath,
+      routeId: route.id,
+      get params() {
+        if (!params) params = offsets ? buildParams(urlPath, route, offsets) : {};
+        return params;
+      },
+    };
+  };
+
+  const match = (urlPath) => fromSpans(routeMatcher.matchInto(urlPath, spans), urlPath);
+  if (typeof routeMatcher.resolveInto !== 'function') {
+    const resolve = (urlPath) => ({ urlPath, headers: NO_RULE_HEADERS, redirect: null, match: match(urlPath) });
+    return { match, resolve };
+  }
+  const resolve = (urlPath) => {
+    const out = routeMatcher.resolveInto(urlPath, spans);
+    if (typeof out === 'number') {
+      return { urlPath, headers: NO_RULE_HEADERS, redirect: null, match: fromSpans(out, urlPath) };
+    }
+    if (out.redirect) {
+      return { urlPath, headers: out.headers, redirect: out.redirect, match: NO_ROUTE_MATCH };
+    }
+    const target = out.urlPath || urlPath;
+    return { urlPath: target, headers: out.headers, redirect: null, match: fromSpans(out.routeId, target) };
+  };
+  return { match, resolve };
+}
+
 function createPagesCompiler(pagesDir) {
   const babel = require('@babel/core');
   const compiledByFilename = new Map();
@@ -661,54 +730,150 @@ function createMiniNextServer(options = {}) {
   const pagesCompiler = createPagesCompiler(pagesDir);
 
   const native = loadNativeAddon();
-  const routeMatcher = new native.RouteMatcher(pagesDir);
-  const ssrCache = new native.SSRCache(Number(options.ssrCacheSize || process.env.SSR_CACHE_SIZE || 512));
-  const isrCache = new Map();
-  const isrIndexByModulePath = new Map();
+  // 生产环境优先加载预构建的路由清单；清单缺失或与 pages 目录不一致时自动退回扫描
+  const routeManifest = isProd
+    ? (options.routeManifest ?? path.join(process.cwd(), '.mini-next', 'routes.bin'))
+    : null;
+  const routeMatcher = routeManifest
+    ? new native.RouteMatcher(pagesDir, { manifest: routeManifest })
+    : new native.RouteMatcher(pagesDir);
+  const routeLookup = createRouteLookup(routeMatcher);
+  if (options.routeRules) {
+    // 规则非法时在启动阶段直接抛错
+    routeMatcher.setRules(options.routeRules);
+  }
+  // 设置了字节预算（ssrCacheMaxBytes / SSR_CACHE_MAX_MB）且没给条目数时只按字节淘汰
+  const ssrCacheMaxBytes = Number(
+    options.ssrCacheMaxBytes || (process.env.SSR_CACHE_MAX_MB ? Number(process.env.SSR_CACHE_MAX_MB) * 1024 * 1024 : 0),
+  );
+  const ssrCacheSize = Number(options.ssrCacheSize || process.env.SSR_CACHE_SIZE || (ssrCacheMaxBytes > 0 ? 0 : 512));
+  // 同一页面并发未命中时只有拿到租约的请求渲染，持有者超过这个时间没有结果就由后来者接手
+  const ssrLeaseTimeoutMs = Number(options.ssrLeaseTimeoutMs || process.env.SSR_LEASE_TIMEOUT_MS || 10000);
+  // 缓存按 key 的 128 位摘要存放；ssrCacheCheckKeys 时另存完整 key 排除摘要碰撞
+  const ssrCacheCheckKeys = Boolean(options.ssrCacheCheckKeys || process.env.SSR_CACHE_CHECK_KEYS === '1');
+  const ssrCache = new native.SSRCache(ssrCacheSize, {
+    shards: Number(options.ssrCacheShards || process.env.SSR_CACHE_SHARDS || 16),
+    maxBytes: ssrCacheMaxBytes,
+    leaseTimeoutMs: ssrLeaseTimeoutMs,
+    checkKeys: ssrCacheCheckKeys,
+  });
+  // ISR 页面放在原生缓存里：过了 revalidate 时间仍先返回旧页面，
+  // 只有拿到租约的那个请求在后台重新生成
+  const isrCacheSizeRaw = Number(options.isrCacheSize || process.env.ISR_CACHE_SIZE || 256);
+  const isrCacheSize = Number.isFinite(isrCacheSizeRaw) && isrCacheSizeRaw > 0 ? isrCacheSizeRaw : 256;
+  const isrCache = new native.SSRCache(isrCacheSize, {
+    shards: Number(options.ssrCacheShards || process.env.SSR_CACHE_SHARDS || 16),
+    leaseTimeoutMs: ssrLeaseTimeoutMs,
+    checkKeys: ssrCacheCheckKeys,
+  });
+  const isrStaleMs = Number(options.isrStaleMs ?? process.env.ISR_STALE_MS ?? Infinity);
   const imageCache = new Map();
   const renderer = pickRenderer(native, options);
   const cleanups = [];
   const hmrClients = new Set();
   const plugins = Array.isArray(options.plugins) ? options.plugins.filter(Boolean) : [];
 
-  function isrIndexAdd(modulePath, key) {
+  // 页面缓存条目都以模块路径为标签，getStaticProps 还可以返回 tags（如数据源 id），
+  // 按标签失效由原生倒排索引完成
+  function isrInvalidateModule(modulePath) {
     const abs = String(modulePath || '');
     if (!abs) return;
-    let set = isrIndexByModulePath.get(abs);
-    if (!set) {
-      set = new Set();
-      isrIndexByModulePath.set(abs, set);
-    }
-    set.add(key);
+    isrCache.invalidateTag(abs);
+  }
+
+  function invalidateTag(tag) {
+    const t = String(tag || '');
+    if (!t) return 0;
+    return ssrCache.invalidateTag(t) + isrCache.invalidateTag(t);
+  }
+
+  function isrClear() {
+    isrCache.clear();
   }
 
-  function isrIndexRemoveKey(key) {
-    for (const set of isrIndexByModulePath.values()) {
-      set.delete(key);
+  // render 返回 { html, entry }，entry 是写缓存的选项。拿到租约的请求渲染后写回并
+  // 唤醒等待者，渲染失败时等待者收到同一个错误；等待超时说明持有者卡住了，
+  // 此时租约也已超时，重新抢租约自己渲染
+  async function renderOnce(cache, key, render) {
+    const lease = cache.acquire(key);
+    if (typeof lease !== 'number') {
+      let timer = null;
+      const timeout = new Promise((resolve) => {
+        timer = setTimeout(resolve, ssrLeaseTimeoutMs + 5, null);
+      });
+      try {
+        const html = await Promise.race([lease, timeout]);
+        if (typeof html === 'string') return html;
+      } finally {
+        clearTimeout(timer);
+      }
+      return renderOnce(cache, key, render);
     }
+    let out;
+    try {
+      out = await render();
+    } catch (err) {
+      cache.fail(key, lease, err);
+      throw err;
+    }
+    cache.complete(key, lease, out.html, out.entry);
+    return out.html;
   }
 
-  function isrInvalidateModule(modulePath) {
-    const abs = String(modulePath || '');
-    if (!abs) return;
-    const set = isrIndexByModulePath.get(abs);
-    if (!set) return;
-    for (const k of set) {
-      isrCache.delete(k);
+  // 路由表在原生线程池里重建后原子替换，请求路径上的 match 不会被阻塞；
+  // 只有恰好赶上重建的请求会等这一次扫描完成，保证新增页面立即可见
+  let rescanInFlight = null;
+  let rescanQueued = false;
+  function scheduleRescan() {
+    if (rescanInFlight) {
+      rescanQueued = true;
+      return rescanInFlight;
     }
-    isrIndexByModulePath.delete(abs);
+    const run = typeof routeMatcher.rescanAsync === 'function'
+      ? routeMatcher.rescanAsync()
+      : Promise.resolve().then(() => routeMatcher.rescan());
+    rescanInFlight = run
+      .catch(() => { })
+      .then(() => {
+        rescanInFlight = null;
+        if (rescanQueued) {
+          rescanQueued = false;
+          return scheduleRescan();
+        }
+      });
+    return rescanInFlight;
   }
 
-  function isrClear() {
-    isrCache.clear();
-    isrIndexByModulePath.clear();
+  // 文件事件按路径攒一批，下一轮事件循环一次性增量更新路由表；
+  // 旧版本原生模块没有 applyChanges 时退回整表重扫
+  const pendingChanges = new Set();
+  let changesScheduled = false;
+  function flushRouteChanges() {
+    changesScheduled = false;
+    const paths = Array.from(pendingChanges);
+    pendingChanges.clear();
+    try {
+      routeMatcher.applyChanges(paths);
+    } catch (_) {
+      scheduleRescan();
+    }
+  }
+  function queueRouteChange(changedPath) {
+    if (!changedPath || typeof routeMatcher.applyChanges !== 'function') {
+      scheduleRescan();
+      return;
+    }
+    pendingChanges.add(changedPath);
+    if (!changesScheduled) {
+      changesScheduled = true;
+      setImmediate(flushRouteChanges);
+    }
   }
 
-  let needsRescan = !isProd;
   if (!isProd && typeof native.FileWatcher === 'function') {
     const watcher = new native.FileWatcher();
     watcher.start(pagesDir, (ev) => {
-      needsRescan = true;
+      queueRouteChange(ev && ev.path ? String(ev.path) : null);
       ssrCache.clear();
       isrClear();
       pagesCompiler.invalidate(ev && ev.path ? String(ev.path) : null);
@@ -795,9 +960,11 @@ function createMiniNextServer(options = {}) {
     const revalidateSec = typeof revalidate === 'number' && Number.isFinite(revalidate) && revalidate > 0
       ? revalidate
       : null;
-    return { props, revalidateSec };
+    const tags = Array.isArray(out.tags) ? out.tags.map(String) : [];
+    return { props, revalidateSec, tags };
   }
 
+  // 缓存 key 按分量传给原生缓存，在 C++ 里逐个流入 hash，不拼接成大字符串
   function isrKey(modulePath, urlPath, params) {
     let p = '';
     try {
@@ -805,14 +972,7 @@ function createMiniNextServer(options = {}) {
     } catch (_) {
       p = '';
     }
-    return `${modulePath}|${urlPath}|${p}`;
-  }
-
-  function isFreshIsr(entry) {
-    if (!entry) return false;
-    if (entry.revalidateMs == null) return true;
-    const age = Date.now() - Number(entry.generatedAt || 0);
-    return age >= 0 && age < entry.revalidateMs;
+    return [modulePath, urlPath, p];
   }
 
   function lruGet(map, key) {
@@ -830,9 +990,6 @@ function createMiniNextServer(options = {}) {
       const first = map.keys().next().value;
       if (first == null) break;
       map.delete(first);
-      if (map === isrCache) {
-        isrIndexRemoveKey(first);
-      }
     }
   }
 
@@ -1029,6 +1186,8 @@ function createMiniNextServer(options = {}) {
           isrClear();
         }
       },
+      // 按标签失效 SSR/ISR 页面，返回删除的条数
+      invalidateTag,
     };
     for (const p of plugins) {
       if (!p || typeof p.apply !== 'function') continue;
@@ -1045,6 +1204,12 @@ function createMiniNextServer(options = {}) {
   });
 
   app.get('/__mini_next__/debug', (req, res) => {
+    let router = null;
+    if (typeof routeMatcher.stats === 'function') {
+      // 按匹配次数倒序，便于看出热点路由
+      router = routeMatcher.stats();
+      router.routes.sort((a, b) => b.matches - a.matches);
+    }
     res.json({
       ok: true,
       isProd,
@@ -1052,6 +1217,8 @@ function createMiniNextServer(options = {}) {
       publicDir,
       ssrMode: renderer.mode,
       devRescanAlways,
+      router,
+      ssrCache: typeof ssrCache.stats === 'function' ? ssrCache.stats() : null,
     });
   });
 
@@ -1062,9 +1229,8 @@ function createMiniNextServer(options = {}) {
     res.json({ ok: true });
   });
 
-  app.post('/__mini_next__/rescan', (req, res) => {
-    routeMatcher.rescan();
-    needsRescan = false;
+  app.post('/__mini_next__/rescan', async (req, res) => {
+    await scheduleRescan();
     res.json({ ok: true });
   });
 
@@ -1235,18 +1401,32 @@ function createMiniNextServer(options = {}) {
   app.get(/.*/, async (req, res) => {
     try {
       if (!isProd) {
-        if (devRescanAlways || needsRescan) {
-          routeMatcher.rescan();
-          needsRescan = false;
+        if (devRescanAlways) {
+          await scheduleRescan();
+        } else {
+          if (changesScheduled) flushRouteChanges();
+          if (rescanInFlight) await rescanInFlight;
         }
       }
 
-      let urlPath = req.path || '/';
+      const resolved = routeLookup.resolve(req.path || '/');
+      for (const [key, value] of resolved.headers) {
+        res.setHeader(key, value);
+      }
+      if (resolved.redirect) {
+        const { status, location } = resolved.redirect;
+        const queryAt = req.originalUrl.indexOf('?');
+        const search = queryAt >= 0 && !location.includes('?') ? req.originalUrl.slice(queryAt) : '';
+        res.redirect(status, location + search);
+        return;
+      }
+
+      let urlPath = resolved.urlPath;
       const reqOut = await runPluginsWithControl('onRequest', { req, res, urlPath });
       if (reqOut.handled) return;
-      urlPath = String(reqOut.ctx.urlPath || urlPath);
-
-      const match = routeMatcher.match(urlPath);
+      const pluginUrlPath = String(reqOut.ctx.urlPath || urlPath);
+      const match = pluginUrlPath === urlPath ? resolved.match : routeLookup.match(pluginUrlPath);
+      urlPath = pluginUrlPath;
       if (!match || match.matched !== true || !match.filePath) {
         const nf = await runPluginsWithControl('onNotFound', { req, res, urlPath });
         if (nf.handled) return;
@@ -1282,19 +1462,93 @@ function createMiniNextServer(options = {}) {
 
       if (isStatic) {
         const key = isrKey(modulePath, urlPath, params);
-        const cached = lruGet(isrCache, key);
-        if (isFreshIsr(cached)) {
+        // background 为 true 时是响应发出之后的重新生成，不再触发针对本次请求的 onRendered
+        const renderIsr = async (background = false) => {
+          const staticOut = await resolveStaticProps(pageModule, ctx);
+          const propsRaw = staticOut ? staticOut.props : { params: ctx.params, query: ctx.query };
+          const props = await applyPropsPlugins(propsRaw, ctx);
+          const revalidateMs = staticOut && staticOut.revalidateSec != null ? staticOut.revalidateSec * 1000 : null;
+
+          const pageData = JSON.stringify({ props, route: { path: urlPath, params } })
+            .replaceAll('<', '\\u003c')
+            .replaceAll('>', '\\u003e')
+            .replaceAll('&', '\\u0026')
+            .replaceAll('\\u2028', '\\u2028')
+            .replaceAll('\\u2029', '\\u2029');
+
+          const scriptsHtml = withDevScripts(await getScriptsHtml(pageModule, Component, ctx));
+
+          const renderOut = await runWithStyleRegistry(async () => {
+            if (renderer.mode === 'native') {
+              const bodyHtml = renderer.renderToString(modulePath, props);
+              return { bodyHtml: String(bodyHtml || '') };
+            }
+            const html = renderer.renderToString(Component, props, {
+              route: { path: urlPath, params },
+              scriptsHtml,
+            });
+            return { html: String(html || '') };
+          });
+
+          const htmlRaw = renderer.mode === 'native'
+            ? native.renderTemplate(
+              '<!doctype html><html lang="en"><head><meta charset="utf-8" /><meta name="viewport" content="width=device-width, initial-scale=1" /><title>{{title}}</title>{{{stylesHtml}}}</head><body><div id="__next">{{{bodyHtml}}}</div><script id="__MINI_NEXT_DATA__" type="application/json">{{{pageData}}}</script>{{{scriptsHtml}}}</body></html>',
+              {
+                title: 'mini-next-cpp',
+                bodyHtml: renderOut.result.bodyHtml,
+                pageData,
+                stylesHtml: renderOut.stylesHtml,
+                scriptsHtml,
+              },
+              false,
+            )
+            : injectStylesHtml(renderOut.result.html, renderOut.stylesHtml);
+          const html = await applyHtmlPlugins(htmlRaw, ctx);
+          if (!background) {
+            await runPlugins('onRendered', { req, res, urlPath, modulePath, params, html });
+          }
+
+          const tags = staticOut ? [modulePath, ...staticOut.tags] : [modulePath];
+          return { html, entry: revalidateMs != null ? { ttlMs: revalidateMs, staleMs: isrStaleMs, tags } : { tags } };
+        };
+
+        const cached = isrCache.lookup(key);
+        if (cached && typeof cached.html === 'string') {
+          if (cached.revalidate) {
+            // 响应照常用旧页面；后台生成失败时租约超时后由后续请求重试
+            setImmediate(() => {
+              renderIsr(true)
+                .then((out) => isrCache.set(key, out.html, out.entry))
+                .catch((err) => {
+                  console.error(`ISR revalidation failed for ${urlPath}:`, err);
+                });
+            });
+          }
           res.setHeader('content-type', 'text/html; charset=utf-8');
           await runPlugins('onResponse', { req, res, urlPath, modulePath, params, statusCode: res.statusCode });
           res.send(cached.html);
           return;
         }
 
-        const staticOut = await resolveStaticProps(pageModule, ctx);
-        const propsRaw = staticOut ? staticOut.props : { params: ctx.params, query: ctx.query };
-        const props = await applyPropsPlugins(propsRaw, ctx);
-        const revalidateMs = staticOut && staticOut.revalidateSec != null ? staticOut.revalidateSec * 1000 : null;
+        const html = await renderOnce(isrCache, key, renderIsr);
+        res.setHeader('content-type', 'text/html; charset=utf-8');
+        await runPlugins('onResponse', { req, res, urlPath, modulePath, params, statusCode: res.statusCode });
+        res.send(html);
+        return;
+      }
+
+      const propsRaw = await resolvePageProps(pageModule, ctx);
+      const props = await applyPropsPlugins(propsRaw, ctx);
+      const cacheKey = [modulePath, urlPath, JSON.stringify(props) ?? ''];
+
+      const cached = ssrCache.get(cacheKey);
+      if (typeof cached === 'string' && cached.length > 0) {
+        res.setHeader('content-type', 'text/html; charset=utf-8');
+        res.send(cached);
+        return;
+      }
 
+      const renderSsr = async () => {
         const pageData = JSON.stringify({ props, route: { path: urlPath, params } })
           .replaceAll('<', '\\u003c')
           .replaceAll('>', '\\u003e')
@@ -1331,65 +1585,9 @@ function createMiniNextServer(options = {}) {
           : injectStylesHtml(renderOut.result.html, renderOut.stylesHtml);
         const html = await applyHtmlPlugins(htmlRaw, ctx);
         await runPlugins('onRendered', { req, res, urlPath, modulePath, params, html });
-
-        const limit = Number(options.isrCacheSize || process.env.ISR_CACHE_SIZE || 256);
-        lruSet(isrCache, key, { html, generatedAt: Date.now(), revalidateMs }, Number.isFinite(limit) && limit > 0 ? limit : 256);
-        isrIndexAdd(modulePath, key);
-
-        res.setHeader('content-type', 'text/html; charset=utf-8');
-        await runPlugins('onResponse', { req, res, urlPath, modulePath, params, statusCode: res.statusCode });
-        res.send(html);
-        return;
-      }
-
-      const propsRaw = await resolvePageProps(pageModule, ctx);
-      const props = await applyPropsPlugins(propsRaw, ctx);
-      const cacheKey = `${modulePath}|${urlPath}|${JSON.stringify(props)}`;
-
-      const cached = ssrCache.get(cacheKey);
-      if (typeof cached === 'string' && cached.length > 0) {
-        res.setHeader('content-type', 'text/html; charset=utf-8');
-        res.send(cached);
-        return;
-      }
-
-      const pageData = JSON.stringify({ props, route: { path: urlPath, params } })
-        .replaceAll('<', '\\u003c')
-        .replaceAll('>', '\\u003e')
-        .replaceAll('&', '\\u0026')
-        .replaceAll('\\u2028', '\\u2028')
-        .replaceAll('\\u2029', '\\u2029');
-
-      const scriptsHtml = withDevScripts(await getScriptsHtml(pageModule, Component, ctx));
-
-      const renderOut = await runWithStyleRegistry(async () => {
-        if (renderer.mode === 'native') {
-          const bodyHtml = renderer.renderToString(modulePath, props);
-          return { bodyHtml: String(bodyHtml || '') };
-        }
-        const html = renderer.renderToString(Component, props, {
-          route: { path: urlPath, params },
-          scriptsHtml,
-        });
-        return { html: String(html || '') };
-      });
-
-      const htmlRaw = renderer.mode === 'native'
-        ? native.renderTemplate(
-          '<!doctype html><html lang="en"><head><meta charset="utf-8" /><meta name="viewport" content="width=device-width, initial-scale=1" /><title>{{title}}</title>{{{stylesHtml}}}</head><body><div id="__next">{{{bodyHtml}}}</div><script id="__MINI_NEXT_DATA__" type="application/json">{{{pageData}}}</script>{{{scriptsHtml}}}</body></html>',
-          {
-            title: 'mini-next-cpp',
-            bodyHtml: renderOut.result.bodyHtml,
-            pageData,
-            stylesHtml: renderOut.stylesHtml,
-            scriptsHtml,
-          },
-          false,
-        )
-        : injectStylesHtml(renderOut.result.html, renderOut.stylesHtml);
-      const html = await applyHtmlPlugins(htmlRaw, ctx);
-      await runPlugins('onRendered', { req, res, urlPath, modulePath, params, html });
-      ssrCache.set(cacheKey, html);
+        return { html, entry: { tags: [modulePath] } };
+      };
+      const html = await renderOnce(ssrCache, cacheKey, renderSsr);
       res.setHeader('content-type', 'text/html; charset=utf-8');
       await runPlugins('onResponse', { req, res, urlPath, modulePath, params, statusCode: res.statusCode });
       res.send(html);
@@ -1423,6 +1621,17 @@ function createMiniNextServer(options = {}) {
   return { app, pagesDir, close };
 }
 
+function buildRouteManifest(options = {}) {
+  const pagesDir = options.pagesDir || path.join(process.cwd(), 'pages');
+  const outFile = options.outFile || path.join(process.cwd(), '.mini-next', 'routes.bin');
+  const native = loadNativeAddon();
+  const matcher = new native.RouteMatcher(pagesDir);
+  if (!matcher.writeManifest(outFile)) {
+    throw new Error(`Failed to write route manifest: ${outFile}`);
+  }
+  return { pagesDir, outFile };
+}
+
 async function startMiniNextDevServer(options = {}) {
   const port = Number(options.port || process.env.PORT || 3000);
   const { app, pagesDir, close } = createMiniNextServer(options);
@@ -1437,7 +1646,7 @@ async function startMiniNextDevServer(options = {}) {
   });
 }
 
-module.exports = { createMiniNextServer, startMiniNextDevServer };
+module.exports = { createMiniNextServer, startMiniNextDevServer, buildRouteManifest };
 
 if (require.main === module) {
   startMiniNextDevServer().catch((err) => {
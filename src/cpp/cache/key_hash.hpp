@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace mini_next {
+
+// 缓存 key 的 128 位摘要。缓存里只存 16 字节，不再保存可能和 HTML 一样长的
+// 完整 key；lo 已经充分混合，直接当 hash 用
+struct KeyDigest {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool operator==(const KeyDigest &o) const { return lo == o.lo && hi == o.hi; }
+  bool operator!=(const KeyDigest &o) const { return !(*this == o); }
+};
+
+struct KeyDigestHash {
+  size_t operator()(const KeyDigest &d) const { return static_cast<size_t>(d.lo); }
+};
+
+// 流式 128 位 hash：key 的各个分量（模块路径、url、props JSON……）逐个 add，
+// 不必先拼成一个大字符串。每个分量先写入长度，["ab", "c"] 与 ["a", "bc"]
+// 不会相同。两条 64 位通道各自用 64x64->128 乘法折叠（wyhash 的 mum），
+// 每 16 字节两次乘法。不是密码学 hash，key 可能被构造时开启缓存的 checkKeys。
+// 按本机字节序读取，摘要只用于进程内缓存，不落盘
+class KeyHasher {
+public:
+  explicit KeyHasher(uint64_t seed = 0) : a_(seed ^ kP0), b_(seed ^ kP1) {}
+
+  void add(std::string_view part) {
+    const uint64_t len = part.size();
+    feed(reinterpret_cast<const unsigned char *>(&len), sizeof(len));
+    feed(reinterpret_cast<const unsigned char *>(part.data()), part.size());
+  }
+
+  KeyDigest digest() const {
+    uint64_t a = a_;
+    uint64_t b = b_;
+    if (bufLen_ > 0) {
+      unsigned char tail[16] = {};
+      std::memcpy(tail, buf_, bufLen_);
+      mix(a, b, read64(tail), read64(tail + 8));
+    }
+    a = mum(a ^ total_ ^ kP2, b ^ kP3);
+    b = mum(b ^ (total_ << 32 | total_ >> 32) ^ kP0, a ^ kP1);
+    return KeyDigest{mum(a ^ kP0, b ^ kP3), mum(b ^ kP1, a ^ kP2)};
+  }
+
+  static KeyDigest hash(std::string_view key) {
+    KeyHasher h;
+    h.add(key);
+    return h.digest();
+  }
+
+private:
+  static constexpr uint64_t kP0 = 0xa0761d6478bd642fULL;
+  static constexpr uint64_t kP1 = 0xe7037ed1a0b428dbULL;
+  static constexpr uint64_t kP2 = 0x8ebc6af09c88c6e3ULL;
+  static constexpr uint64_t kP3 = 0x589965cc75374cc3ULL;
+
+  static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static uint64_t mum(uint64_t x, uint64_t y) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 u128;
+    const u128 r = static_cast<u128>(x) * y;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+    const uint64_t xl = x & 0xffffffffULL, xh = x >> 32;
+    const uint64_t yl = y & 0xffffffffULL, yh = y >> 32;
+    const uint64_t ll = xl * yl, lh = xl * yh, hl = xh * yl, hh = xh * yh;
+    const uint64_t mid = (ll >> 32) + (lh & 0xffffffffULL) + (hl & 0xffffffffULL);
+    const uint64_t lo = (mid << 32) | (ll & 0xffffffffULL);
+    const uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return lo ^ hi;
+#endif
+  }
+
+  // 两条通道对同一块用不同的配对和常数，一条被特殊输入清零时另一条不受影响
+  static void mix(uint64_t &a, uint64_t &b, uint64_t w0, uint64_t w1) {
+    a = mum(w0 ^ a ^ kP1, w1 ^ kP2);
+    b = mum(w1 ^ b ^ kP3, w0 ^ kP0);
+  }
+
+  void feed(const unsigned char *p, size_t n) {
+    total_ += n;
+    if (bufLen_ > 0) {
+      const size_t take = n < 16 - bufLen_ ? n : 16 - bufLen_;
+      std::memcpy(buf_ + bufLen_, p, take);
+      bufLen_ += take;
+      p += take;
+      n -= take;
+      if (bufLen_ < 16) {
+        return;
+      }
+      mix(a_, b_, read64(buf_), read64(buf_ + 8));
+      bufLen_ = 0;
+    }
+    for (; n >= 16; p += 16, n -= 16) {
+      mix(a_, b_, read64(p), read64(p + 8));
+    }
+    if (n > 0) {
+      std::memcpy(buf_, p, n);
+      bufLen_ = n;
+    }
+  }
+
+  uint64_t a_;
+  uint64_t b_;
+  uint64_t total_ = 0;
+  unsigned char buf_[16] = {};
+  size_t bufLen_ = 0;
+};
+
+} // namespace mini_next
@@ -1,5 +1,7 @@
 #include "lru_cache.hpp"
 
+#include <memory>
 #include <string>
 
 template class ConcurrentLRUCache<std::string, std::string>;
+template class ShardedLRUCache<std::string, std::shared_ptr<const std::string>>;
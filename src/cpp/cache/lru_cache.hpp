@@ -1,9 +1,19 @@
+#pragma once
+
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 template <typename K, typename V> class ConcurrentLRUCache {
 public:
@@ -66,3 +76,264 @@ private:
   std::list<K> lruList_;
   std::unordered_map<K, std::pair<V, typename std::list<K>::iterator>> cache_;
 };
+
+// 分片的近似 LRU：按 key 的 hash 分到各分片，每个分片一把读写锁。
+// 淘汰用 CLOCK（second chance）：命中只在共享锁下重置一个原子的信用值，
+// 不移动链表节点，所以同一分片的读也可以并行；写入时指针扫过信用值非零的
+// 条目减一跳过，淘汰第一个信用值为零的。
+// maxBytes 非零时按字节预算淘汰（调用方在 put 时给出条目字节数），并近似
+// GreedyDual-Size：条目越小、信用值越高，能多熬过几轮指针扫描，同样的预算
+// 里留住更多条目。capacity 为 0 时只受字节预算限制。
+// 设置了 listener 时，条目进出缓存（写入、覆盖、删除、淘汰、清空）都在分片锁内
+// 回调一次，调用方可以据此维护与缓存内容严格一致的辅助索引。
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ShardedLRUCache {
+public:
+  explicit ShardedLRUCache(size_t capacity, size_t shardCount = 16,
+                           size_t maxBytes = 0) {
+    if (shardCount == 0) {
+      shardCount = 1;
+    }
+    size_t perShard = 0;
+    if (capacity == 0 && maxBytes > 0) {
+      perShard = std::numeric_limits<size_t>::max();
+    } else {
+      if (capacity == 0) {
+        capacity = 1;
+      }
+      if (shardCount > capacity) {
+        shardCount = capacity;
+      }
+      perShard = (capacity + shardCount - 1) / shardCount;
+    }
+    const size_t byteBudget =
+        maxBytes == 0 ? 0 : (maxBytes + shardCount - 1) / shardCount;
+    shards_.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; i++) {
+      shards_.push_back(std::make_unique<Shard>(perShard, byteBudget));
+    }
+    maxBytes_ = maxBytes;
+  }
+
+  std::optional<V> get(const K &key) {
+    Shard &shard = shardFor(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      return std::nullopt;
+    }
+    Slot &slot = shard.slots[it->second];
+    slot.credit.store(slot.weight, std::memory_order_relaxed);
+    return slot.value;
+  }
+
+  // 只查是否存在，不算一次访问
+  bool contains(const K &key) const {
+    const Shard &shard = shardFor(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.index.count(key) != 0;
+  }
+
+  // 超过单个分片字节预算的条目不缓存，返回 false
+  bool put(const K &key, const V &value, size_t bytes = 0) {
+    Shard &shard = shardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      Slot &slot = shard.slots[it->second];
+      if (shard.byteBudget == 0) {
+        if (shard.listener) {
+          shard.listener(slot.key, slot.value, false);
+        }
+        slot.value = value;
+        shard.bytes += bytes - slot.bytes;
+        slot.bytes = bytes;
+        slot.credit.store(slot.weight, std::memory_order_relaxed);
+        if (shard.listener) {
+          shard.listener(slot.key, slot.value, true);
+        }
+        return true;
+      }
+      // 大小变了，先摘掉旧条目再按新大小插入，免得腾空间时淘汰到它自己
+      shard.release(it->second);
+      shard.index.erase(it);
+    }
+    if (shard.byteBudget > 0 && bytes > shard.byteBudget) {
+      return false;
+    }
+    while (!shard.hasRoom(bytes)) {
+      shard.evict();
+    }
+    const size_t pos = shard.acquire();
+    Slot &slot = shard.slots[pos];
+    slot.key = key;
+    slot.value = value;
+    slot.bytes = bytes;
+    slot.used = true;
+    slot.weight = shard.weightFor(bytes);
+    // 新条目比命中过的少一格信用，只访问一次的条目先被淘汰
+    slot.credit.store(static_cast<uint8_t>(slot.weight - 1),
+                      std::memory_order_relaxed);
+    shard.bytes += bytes;
+    shard.index.emplace(key, pos);
+    if (shard.listener) {
+      shard.listener(slot.key, slot.value, true);
+    }
+    return true;
+  }
+
+  void erase(const K &key) {
+    Shard &shard = shardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.release(it->second);
+      shard.index.erase(it);
+    }
+  }
+
+  void clear() {
+    for (auto &shard : shards_) {
+      std::unique_lock<std::shared_mutex> lock(shard->mutex);
+      for (const auto &kv : shard->index) {
+        shard->release(kv.second);
+      }
+      shard->index.clear();
+    }
+  }
+
+  size_t size() const {
+    size_t n = 0;
+    for (const auto &shard : shards_) {
+      std::shared_lock<std::shared_mutex> lock(shard->mutex);
+      n += shard->index.size();
+    }
+    return n;
+  }
+
+  size_t bytes() const {
+    size_t n = 0;
+    for (const auto &shard : shards_) {
+      std::shared_lock<std::shared_mutex> lock(shard->mutex);
+      n += shard->bytes;
+    }
+    return n;
+  }
+
+  size_t maxBytes() const { return maxBytes_; }
+  size_t shardCount() const { return shards_.size(); }
+
+  // inserted 为 false 表示条目离开缓存。回调里不能再访问本缓存；
+  // 须在并发使用前设置
+  using Listener =
+      std::function<void(const K &key, const V &value, bool inserted)>;
+  void setListener(Listener listener) {
+    for (auto &shard : shards_) {
+      shard->listener = listener;
+    }
+  }
+
+private:
+  static constexpr uint8_t kMaxWeight = 3;
+
+  struct Slot {
+    K key{};
+    V value{};
+    size_t bytes = 0;
+    bool used = false;
+    uint8_t weight = 1; // 命中时恢复到的信用值
+    std::atomic<uint8_t> credit{0};
+  };
+
+  struct alignas(64) Shard {
+    Shard(size_t capacity, size_t byteBudget)
+        : capacity(capacity), byteBudget(byteBudget) {
+      if (byteBudget == 0) {
+        index.reserve(capacity);
+      }
+    }
+
+    bool hasRoom(size_t need) const {
+      if (byteBudget > 0 && bytes + need > byteBudget) {
+        return false;
+      }
+      return !free.empty() || slots.size() < capacity;
+    }
+
+    // 大小相对分片预算每小一个数量级（16 倍）多一格信用
+    uint8_t weightFor(size_t need) const {
+      if (byteBudget == 0) {
+        return 1;
+      }
+      uint8_t w = 1;
+      for (size_t limit = byteBudget / 16; w < kMaxWeight && need <= limit;
+           limit /= 16) {
+        w++;
+      }
+      return w;
+    }
+
+    size_t acquire() {
+      if (!free.empty()) {
+        const size_t pos = free.back();
+        free.pop_back();
+        return pos;
+      }
+      slots.emplace_back();
+      return slots.size() - 1;
+    }
+
+    // 只在分片非空时调用；信用值最多 kMaxWeight，指针至多扫 kMaxWeight + 1 圈
+    void evict() {
+      for (;;) {
+        const size_t pos = hand;
+        hand = (hand + 1) % slots.size();
+        Slot &slot = slots[pos];
+        if (!slot.used) {
+          continue;
+        }
+        const uint8_t c = slot.credit.load(std::memory_order_relaxed);
+        if (c > 0) {
+          slot.credit.store(static_cast<uint8_t>(c - 1),
+                            std::memory_order_relaxed);
+          continue;
+        }
+        index.erase(slot.key);
+        release(pos);
+        return;
+      }
+    }
+
+    void release(size_t pos) {
+      Slot &slot = slots[pos];
+      if (listener) {
+        listener(slot.key, slot.value, false);
+      }
+      bytes -= slot.bytes;
+      slot.key = K{};
+      slot.value = V{};
+      slot.bytes = 0;
+      slot.used = false;
+      free.push_back(pos);
+    }
+
+    mutable std::shared_mutex mutex;
+    std::deque<Slot> slots; // 按需增长，deque 扩容不移动已有槽位
+    size_t capacity;
+    size_t byteBudget;
+    size_t bytes = 0;
+    size_t hand = 0;
+    std::vector<size_t> free;
+    std::unordered_map<K, size_t, Hash> index;
+    Listener listener;
+  };
+
+  Shard &shardFor(const K &key) const {
+    // 与分片内 unordered_map 用同一个 hash，取高位分片，避免与桶下标相关
+    const size_t h = Hash{}(key);
+    return *shards_[(h >> 16) % shards_.size()];
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  size_t maxBytes_ = 0;
+};
@@ -1,21 +1,179 @@
-#include "lru_cache.hpp"
+#include "ssr_cache.hpp"
 
+#include <chrono>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <utility>
 
 namespace mini_next {
 
-class SSRCache {
-public:
-  explicit SSRCache(size_t capacity) : cache_(capacity) {}
+SSRCache::SSRCache(size_t capacity, size_t shards, size_t maxBytes,
+                   int64_t leaseTimeoutMs, bool checkKeys)
+    : cache_(capacity, shards, maxBytes), leaseTimeoutMs_(leaseTimeoutMs),
+      checkKeys_(checkKeys) {
+  cache_.setListener(
+      [this](const KeyDigest &key, const std::shared_ptr<const Entry> &entry,
+             bool inserted) { onEntry(key, entry, inserted); });
+}
 
-  std::optional<std::string> get(const std::string &key) { return cache_.get(key); }
-  void set(const std::string &key, const std::string &value) { cache_.put(key, value); }
-  void erase(const std::string &key) { cache_.erase(key); }
-  void clear() { cache_.clear(); }
+int64_t SSRCache::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
 
-private:
-  ConcurrentLRUCache<std::string, std::string> cache_;
-};
+SSRCache::Value SSRCache::get(const SSRCacheKey &key) {
+  Lookup out = lookup(key);
+  return std::move(out.html);
+}
+
+SSRCache::Lookup SSRCache::lookup(const SSRCacheKey &key) {
+  Lookup out;
+  std::optional<std::shared_ptr<const Entry>> found = cache_.get(key.digest);
+  if (!found) {
+    return out;
+  }
+  const std::shared_ptr<const Entry> &entry = *found;
+  if (checkKeys_ && entry->key != key.text) {
+    keyCollisions_.fetch_add(1, std::memory_order_relaxed);
+    return out;
+  }
+  if (entry->freshUntil != 0) {
+    const int64_t now = nowMs();
+    if (now >= entry->freshUntil) {
+      if (entry->staleUntil != 0 && now >= entry->staleUntil) {
+        out.state = SSRCacheState::Expired;
+        return out;
+      }
+      out.state = SSRCacheState::Stale;
+      // 没人持有或租约已超时才去抢，抢到的那一个负责重新生成
+      int64_t at = entry->revalidateAt.load(std::memory_order_relaxed);
+      if ((at == 0 || now - at >= leaseTimeoutMs_) &&
+          entry->revalidateAt.compare_exchange_strong(
+              at, now, std::memory_order_relaxed)) {
+        out.revalidate = true;
+      }
+      out.html = Value(entry, &entry->html);
+      return out;
+    }
+  }
+  out.state = SSRCacheState::Fresh;
+  out.html = Value(entry, &entry->html);
+  return out;
+}
+
+bool SSRCache::set(const SSRCacheKey &key, std::string value,
+                   SSRCacheEntryOptions options) {
+  auto entry = std::make_shared<Entry>();
+  if (checkKeys_) {
+    entry->key.assign(key.text.data(), key.text.size());
+  }
+  const size_t bytes = sizeof(KeyDigest) + entry->key.size() + value.size();
+  entry->html = std::move(value);
+  if (options.ttlMs > 0) {
+    entry->freshUntil = nowMs() + options.ttlMs;
+    if (options.staleMs >= 0) {
+      entry->staleUntil = entry->freshUntil + options.staleMs;
+    }
+  }
+  entry->tags = std::move(options.tags);
+  return cache_.put(key.digest, std::move(entry), bytes);
+}
+
+void SSRCache::erase(const SSRCacheKey &key) { cache_.erase(key.digest); }
+
+void SSRCache::clear() { cache_.clear(); }
+
+void SSRCache::onEntry(const KeyDigest &key,
+                       const std::shared_ptr<const Entry> &entry,
+                       bool inserted) {
+  if (!entry || entry->tags.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(tagMutex_);
+  for (const auto &tag : entry->tags) {
+    if (inserted) {
+      tagIndex_[tag].insert(key);
+      continue;
+    }
+    auto it = tagIndex_.find(tag);
+    if (it != tagIndex_.end()) {
+      it->second.erase(key);
+      if (it->second.empty()) {
+        tagIndex_.erase(it);
+      }
+    }
+  }
+}
+
+size_t SSRCache::invalidateTag(const std::string &tag) {
+  std::unordered_set<KeyDigest, KeyDigestHash> keys;
+  {
+    std::lock_guard<std::mutex> lock(tagMutex_);
+    auto it = tagIndex_.find(tag);
+    if (it == tagIndex_.end()) {
+      return 0;
+    }
+    keys = std::move(it->second);
+    tagIndex_.erase(it);
+  }
+  // 删除时 listener 再把这些 key 从它们的其他标签里摘掉
+  for (const auto &key : keys) {
+    cache_.erase(key);
+  }
+  return keys.size();
+}
+
+uint64_t SSRCache::acquireLease(const SSRCacheKey &key) {
+  const int64_t now = nowMs();
+  std::lock_guard<std::mutex> lock(leaseMutex_);
+  auto it = leases_.find(key.digest);
+  if (it != leases_.end() && now - it->second.startedAt < leaseTimeoutMs_) {
+    return 0;
+  }
+  // 持有者崩溃、没有释放的租约只在这里回收；表变大时顺手清掉超时的
+  if (it == leases_.end() && leases_.size() >= 1024) {
+    for (auto l = leases_.begin(); l != leases_.end();) {
+      l = now - l->second.startedAt >= leaseTimeoutMs_ ? leases_.erase(l)
+                                                       : std::next(l);
+    }
+  }
+  Lease &lease = leases_[key.digest];
+  lease.token = nextLease_++;
+  lease.startedAt = now;
+  return lease.token;
+}
+
+bool SSRCache::releaseLease(const KeyDigest &key, uint64_t token) {
+  std::lock_guard<std::mutex> lock(leaseMutex_);
+  auto it = leases_.find(key);
+  if (it == leases_.end() || it->second.token != token) {
+    return false;
+  }
+  leases_.erase(it);
+  return true;
+}
+
+bool SSRCache::completeLease(const SSRCacheKey &key, uint64_t token,
+                             std::string value, SSRCacheEntryOptions options) {
+  // 先写缓存再放租约，放租约之后来的调用方一定能命中
+  set(key, std::move(value), std::move(options));
+  return releaseLease(key.digest, token);
+}
+
+bool SSRCache::failLease(const SSRCacheKey &key, uint64_t token) {
+  return releaseLease(key.digest, token);
+}
+
+size_t SSRCache::leaseCount() const {
+  std::lock_guard<std::mutex> lock(leaseMutex_);
+  return leases_.size();
+}
+
+size_t SSRCache::tagCount() const {
+  std::lock_guard<std::mutex> lock(tagMutex_);
+  return tagIndex_.size();
+}
 
 } // namespace mini_next
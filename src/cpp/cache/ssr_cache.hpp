@@ -0,0 +1,143 @@
+#pragma once
+
+#include "key_hash.hpp"
+#include "lru_cache.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mini_next {
+
+enum class SSRCacheState {
+  Miss,
+  Fresh,
+  Stale,   // 过了 ttl 但还在 stale 窗口内，照常返回，同时需要有人重新生成
+  Expired, // 超出 stale 窗口，当作未命中
+};
+
+struct SSRCacheEntryOptions {
+  int64_t ttlMs = 0;    // <= 0 表示永不过期
+  int64_t staleMs = -1; // < 0 表示过期后一直可以返回旧值
+  // 用于批量失效的标签，比如页面模块路径、数据源 id
+  std::vector<std::string> tags;
+};
+
+// 缓存 key。条目按 128 位摘要存放，完整 key 不进缓存；开启 checkKeys 时
+// text 是完整 key，与条目里保存的一份比对，排除摘要碰撞。text 只在调用期间使用
+struct SSRCacheKey {
+  KeyDigest digest;
+  std::string_view text;
+
+  SSRCacheKey(const KeyDigest &d, std::string_view t = std::string_view())
+      : digest(d), text(t) {}
+  SSRCacheKey(std::string_view key) : digest(KeyHasher::hash(key)), text(key) {}
+  SSRCacheKey(const std::string &key) : SSRCacheKey(std::string_view(key)) {}
+  SSRCacheKey(const char *key) : SSRCacheKey(std::string_view(key)) {}
+};
+
+// SSR / ISR 结果缓存。值用 shared_ptr 保存，命中时只增加引用计数，
+// 大段 HTML 不在分片锁内复制。maxBytes 非零时按摘要 + HTML 的字节数计入预算，
+// capacity 为 0 则只按字节淘汰。
+// 条目可以带 ttl：过期后的 stale 窗口里 lookup 仍返回旧 HTML，并只让一个
+// 调用方拿到重新生成的租约；租约超过 leaseTimeoutMs 没有写回新值时
+// 视为失败，下一个调用方重新拿到租约。
+// 标签的倒排索引随条目进出缓存在分片锁内维护，淘汰一条的代价只和它的标签数
+// 有关；invalidateTag 只访问命中的条目。
+// 未命中的 key 用 single-flight 租约合并生成：acquireLease 只给第一个调用方
+// 发租约号，其余调用方等它 completeLease / failLease；租约同样在
+// leaseTimeoutMs 后失效，可以被下一个调用方接手。
+class SSRCache {
+public:
+  using Value = std::shared_ptr<const std::string>;
+
+  struct Lookup {
+    Value html; // Fresh / Stale 时非空
+    SSRCacheState state = SSRCacheState::Miss;
+    bool revalidate = false; // 本次调用方拿到了重新生成的租约
+  };
+
+  explicit SSRCache(size_t capacity, size_t shards = 16, size_t maxBytes = 0,
+                    int64_t leaseTimeoutMs = 30000, bool checkKeys = false);
+  // listener 捕获了 this，不能复制或移动
+  SSRCache(const SSRCache &) = delete;
+  SSRCache &operator=(const SSRCache &) = delete;
+
+  // 不关心 ttl 状态的读取：Fresh 与 Stale 都返回 HTML
+  Value get(const SSRCacheKey &key);
+  Lookup lookup(const SSRCacheKey &key);
+  bool contains(const SSRCacheKey &key) const {
+    return cache_.contains(key.digest);
+  }
+  // 单条超过分片预算（maxBytes / 分片数）时不缓存，返回 false
+  bool set(const SSRCacheKey &key, std::string value,
+           SSRCacheEntryOptions options = SSRCacheEntryOptions());
+  void erase(const SSRCacheKey &key);
+  // 删除带该标签的全部条目，返回删除的条数
+  size_t invalidateTag(const std::string &tag);
+  size_t tagCount() const;
+  // 返回非 0 的租约号表示调用方负责生成；0 表示已有未超时的租约在生成
+  uint64_t acquireLease(const SSRCacheKey &key);
+  // 写入结果并释放租约。租约已超时被接手时仍写入（结果本身有效），
+  // 但不释放新持有者的租约；返回 token 是否仍是当前租约
+  bool completeLease(const SSRCacheKey &key, uint64_t token, std::string value,
+                     SSRCacheEntryOptions options = SSRCacheEntryOptions());
+  bool failLease(const SSRCacheKey &key, uint64_t token);
+  size_t leaseCount() const;
+  bool checkKeys() const { return checkKeys_; }
+  // checkKeys 模式下摘要相同、完整 key 不同而按未命中处理的次数
+  uint64_t keyCollisions() const {
+    return keyCollisions_.load(std::memory_order_relaxed);
+  }
+  void clear();
+  size_t size() const { return cache_.size(); }
+  size_t bytes() const { return cache_.bytes(); }
+  size_t maxBytes() const { return cache_.maxBytes(); }
+  size_t shardCount() const { return cache_.shardCount(); }
+
+private:
+  struct Entry {
+    std::string html;
+    int64_t freshUntil = 0; // 0 表示永不过期
+    int64_t staleUntil = 0; // 0 表示 stale 不设上限
+    std::vector<std::string> tags;
+    std::string key; // 只在 checkKeys 时保存
+    // 重新生成租约的起始时间，0 表示没人持有；同一条目的并发读者靠它选出一个
+    mutable std::atomic<int64_t> revalidateAt{0};
+  };
+
+  struct Lease {
+    uint64_t token = 0;
+    int64_t startedAt = 0;
+  };
+
+  static int64_t nowMs();
+  bool releaseLease(const KeyDigest &key, uint64_t token);
+  void onEntry(const KeyDigest &key, const std::shared_ptr<const Entry> &entry,
+               bool inserted);
+
+  ShardedLRUCache<KeyDigest, std::shared_ptr<const Entry>, KeyDigestHash>
+      cache_;
+  int64_t leaseTimeoutMs_;
+  bool checkKeys_;
+  std::atomic<uint64_t> keyCollisions_{0};
+  // 加锁顺序固定为先分片锁、后 tagMutex_：invalidateTag 取走集合后先放锁
+  // 再删条目
+  mutable std::mutex tagMutex_;
+  std::unordered_map<std::string,
+                     std::unordered_set<KeyDigest, KeyDigestHash>>
+      tagIndex_;
+  mutable std::mutex leaseMutex_; // 不与分片锁、tagMutex_ 嵌套
+  std::unordered_map<KeyDigest, Lease, KeyDigestHash> leases_;
+  uint64_t nextLease_ = 1;
+};
+
+} // namespace mini_next
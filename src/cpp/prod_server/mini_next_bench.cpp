@@ -0,0 +1,951 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// mini_next_serve 的压测工具：多线程、长连接、可设流水线深度；
+// --rate 为开环模式（按固定速率发请求，延迟从计划发送时刻算起，
+// 不会因为服务端变慢而少发请求；发送时刻用 CLOCK_MONOTONIC 的 timerfd
+// 以纳秒精度唤醒，实际发送比计划晚多少单独统计为 send lag）。--scenarios 会在临时目录启动一个
+// mini_next_serve，依次跑小文件/大文件/SPA 回退/404 场景。
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+// HDR 风格直方图：每个二进制数量级分 1024 个线性桶，相对误差约 0.1%，
+// 记录与合并都是 O(1)，可以在每个线程里各记一份最后合并
+class Histogram {
+public:
+  Histogram() : counts_(kSub + 54 * kHalf, 0) {}
+
+  void record(uint64_t v) {
+    counts_[index(v)]++;
+    total_++;
+    sum_ += v;
+    max_ = std::max(max_, v);
+  }
+
+  void merge(const Histogram &o) {
+    for (size_t i = 0; i < counts_.size(); i++)
+      counts_[i] += o.counts_[i];
+    total_ += o.total_;
+    sum_ += o.sum_;
+    max_ = std::max(max_, o.max_);
+  }
+
+  uint64_t percentile(double p) const {
+    if (total_ == 0)
+      return 0;
+    const uint64_t target =
+        std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100.0 * (double)total_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      seen += counts_[i];
+      if (seen >= target)
+        return std::min(valueAt(i), max_);
+    }
+    return max_;
+  }
+
+  uint64_t count() const { return total_; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? (double)sum_ / (double)total_ : 0; }
+
+private:
+  static constexpr int kSubBits = 11;
+  static constexpr size_t kSub = size_t(1) << kSubBits;
+  static constexpr size_t kHalf = kSub / 2;
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+
+  static size_t index(uint64_t v) {
+    if (v < kSub)
+      return (size_t)v;
+    const int msb = 63 - __builtin_clzll(v);
+    const int shift = msb - (kSubBits - 1);
+    return kSub + (size_t)(shift - 1) * kHalf + (size_t)((v >> shift) - kHalf);
+  }
+
+  // 桶的中点
+  static uint64_t valueAt(size_t idx) {
+    if (idx < kSub)
+      return idx;
+    const size_t k = idx - kSub;
+    const int shift = (int)(k / kHalf) + 1;
+    const uint64_t base = (uint64_t)(k % kHalf + kHalf) << shift;
+    return base + ((uint64_t(1) << shift) >> 1);
+  }
+};
+
+struct BenchOptions {
+  std::string host = "127.0.0.1";
+  int port = 3000;
+  std::vector<std::string> paths;
+  int connections = 64;
+  int threads = 2;
+  int pipeline = 1;
+  double rate = 0; // 0 表示闭环：每个连接保持 pipeline 个请求在途
+  double durationSec = 10;
+  double warmupSec = 1;
+  int expectStatus = 0; // 非 0 时其他状态码计为错误
+};
+
+struct BenchResult {
+  Histogram latency;
+  Histogram sendLag; // 开环模式：实际发送时刻减计划时刻
+  uint64_t requests = 0;
+  uint64_t bytes = 0;
+  uint64_t status[6] = {0, 0, 0, 0, 0, 0};
+  uint64_t errors = 0;
+  uint64_t unexpected = 0;
+  uint64_t reconnects = 0;
+  double elapsedSec = 0;
+
+  void merge(const BenchResult &o) {
+    latency.merge(o.latency);
+    sendLag.merge(o.sendLag);
+    requests += o.requests;
+    bytes += o.bytes;
+    for (int i = 0; i < 6; i++)
+      status[i] += o.status[i];
+    errors += o.errors;
+    unexpected += o.unexpected;
+    reconnects += o.reconnects;
+  }
+};
+
+struct BenchConn {
+  int fd = -1;
+  bool connected = false;
+  bool wantWrite = false;
+  std::string out;
+  size_t outOff = 0;
+  std::string in;
+  size_t inOff = 0;
+  bool haveHead = false;
+  uint64_t bodyRemaining = 0;
+  uint64_t responseBytes = 0;
+  int status = 0;
+  bool closeAfter = false;
+  std::deque<int64_t> inflight; // 每个在途请求的计划发送时刻
+  std::deque<int64_t> resend;   // 连接断开后需要重发的请求
+  size_t nextPath = 0;
+};
+
+static constexpr size_t kMaxResponseHead = 16384;
+
+class BenchThread {
+public:
+  BenchThread(const BenchOptions &opts, const sockaddr_in &addr, int conns,
+              double rate, int64_t startNs, size_t pathOffset)
+      : opts_(opts), addr_(addr), rate_(rate), startNs_(startNs),
+        conns_((size_t)conns) {
+    for (size_t i = 0; i < conns_.size(); i++)
+      conns_[i].nextPath = pathOffset + i;
+    for (const auto &p : opts_.paths) {
+      requests_.push_back("GET " + p + " HTTP/1.1\r\nHost: " + opts_.host +
+                          ":" + std::to_string(opts_.port) +
+                          "\r\nUser-Agent: mini_next_bench\r\n\r\n");
+    }
+  }
+
+  ~BenchThread() {
+    for (auto &c : conns_) {
+      if (c.fd >= 0)
+        ::close(c.fd);
+    }
+    if (timerFd_ >= 0)
+      ::close(timerFd_);
+    if (epfd_ >= 0)
+      ::close(epfd_);
+  }
+
+  BenchThread(const BenchThread &) = delete;
+  BenchThread &operator=(const BenchThread &) = delete;
+
+  void run() {
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+      std::perror("epoll_create1");
+      return;
+    }
+    warmupEndNs_ = startNs_ + (int64_t)(opts_.warmupSec * 1e9);
+    endNs_ = warmupEndNs_ + (int64_t)(opts_.durationSec * 1e9);
+    nextDueNs_ = startNs_;
+    // epoll_wait 的超时只有毫秒精度，开环模式改由 timerfd 在计划时刻唤醒
+    if (rate_ > 0) {
+      timerFd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (timerFd_ < 0) {
+        std::perror("timerfd_create");
+        return;
+      }
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.u64 = kTimerTag;
+      ::epoll_ctl(epfd_, EPOLL_CTL_ADD, timerFd_, &ev);
+    }
+    for (size_t i = 0; i < conns_.size(); i++)
+      connect(i);
+
+    epoll_event events[256];
+    while (true) {
+      const int64_t now = nowNs();
+      if (now >= endNs_)
+        break;
+      if (rate_ > 0) {
+        issueScheduled(now);
+        armTimer(now);
+      }
+      const int timeoutMs = (int)((endNs_ - now) / 1000000) + 1;
+      const int n = ::epoll_wait(epfd_, events, 256, timeoutMs);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        std::perror("epoll_wait");
+        return;
+      }
+      for (int i = 0; i < n; i++) {
+        if (events[i].data.u64 == kTimerTag) {
+          uint64_t expirations;
+          (void)!::read(timerFd_, &expirations, sizeof(expirations));
+          armedNs_ = 0;
+          continue;
+        }
+        const size_t idx = (size_t)events[i].data.u64;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+          // 连接失败或被重置
+          if (!conns_[idx].connected)
+            result.errors++;
+          reconnect(idx, true);
+          continue;
+        }
+        if (events[i].events & EPOLLOUT)
+          onWritable(idx);
+        if (events[i].events & EPOLLIN)
+          onReadable(idx);
+      }
+    }
+    const int64_t measured = std::max<int64_t>(0, nowNs() - warmupEndNs_);
+    result.elapsedSec = (double)measured / 1e9;
+  }
+
+  BenchResult result;
+
+private:
+  const BenchOptions &opts_;
+  sockaddr_in addr_;
+  double rate_;
+  int64_t startNs_;
+  int64_t warmupEndNs_ = 0;
+  int64_t endNs_ = 0;
+  int64_t nextDueNs_ = 0;
+  size_t nextConn_ = 0;
+  int epfd_ = -1;
+  int timerFd_ = -1;
+  int64_t armedNs_ = 0; // timerfd 当前的到期时刻，0 表示未设置
+  std::vector<BenchConn> conns_;
+
+  static constexpr uint64_t kTimerTag = ~uint64_t(0);
+
+  // 下一个计划时刻还没到就按绝对时刻设置 timerfd（steady_clock 即
+  // CLOCK_MONOTONIC）。已经到期说明连接都占满了，这时不设置，等响应
+  // 回来时再发，避免空转
+  void armTimer(int64_t now) {
+    const int64_t due = nextDueNs_ > now && nextDueNs_ < endNs_ ? nextDueNs_ : 0;
+    if (due == armedNs_)
+      return;
+    itimerspec its{};
+    its.it_value.tv_sec = (time_t)(due / 1000000000);
+    its.it_value.tv_nsec = (long)(due % 1000000000);
+    ::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &its, nullptr);
+    armedNs_ = due;
+  }
+  std::vector<std::string> requests_;
+
+  void connect(size_t idx) {
+    auto &c = conns_[idx];
+    c.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd < 0) {
+      result.errors++;
+      return;
+    }
+    int one = 1;
+    ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const int rc = ::connect(c.fd, (const sockaddr *)&addr_, sizeof(addr_));
+    if (rc != 0 && errno != EINPROGRESS) {
+      result.errors++;
+      ::close(c.fd);
+      c.fd = -1;
+      return;
+    }
+    c.connected = false;
+    c.wantWrite = true;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u64 = idx;
+    ::epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+  }
+
+  // 服务端关闭连接（connection: close、max-requests）或出错时重连；
+  // 在途请求保留计划时刻重新发送
+  void reconnect(size_t idx, bool error) {
+    auto &c = conns_[idx];
+    if (c.fd >= 0) {
+      ::epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+      ::close(c.fd);
+      c.fd = -1;
+    }
+    if (error && c.connected)
+      result.errors++;
+    result.reconnects++;
+    for (const int64_t t : c.inflight)
+      c.resend.push_back(t);
+    c.inflight.clear();
+    c.out.clear();
+    c.outOff = 0;
+    c.in.clear();
+    c.inOff = 0;
+    c.haveHead = false;
+    c.bodyRemaining = 0;
+    c.closeAfter = false;
+    if (nowNs() < endNs_)
+      connect(idx);
+  }
+
+  void setWantWrite(size_t idx, bool want) {
+    auto &c = conns_[idx];
+    if (c.wantWrite == want || c.fd < 0)
+      return;
+    c.wantWrite = want;
+    epoll_event ev{};
+    ev.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = idx;
+    ::epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+  }
+
+  void enqueueRequest(size_t idx, int64_t scheduledNs) {
+    auto &c = conns_[idx];
+    c.out.append(requests_[c.nextPath % requests_.size()]);
+    c.nextPath++;
+    c.inflight.push_back(scheduledNs);
+  }
+
+  // 闭环：补满流水线；开环：只重发断线前的请求，新请求由 issueScheduled 发
+  void fill(size_t idx) {
+    auto &c = conns_[idx];
+    if (!c.connected || c.closeAfter)
+      return;
+    while (!c.resend.empty() && (int)c.inflight.size() < opts_.pipeline) {
+      enqueueRequest(idx, c.resend.front());
+      c.resend.pop_front();
+    }
+    if (rate_ <= 0) {
+      const int64_t now = nowNs();
+      while ((int)c.inflight.size() < opts_.pipeline && now < endNs_)
+        enqueueRequest(idx, now);
+    }
+    flushOut(idx);
+  }
+
+  void issueScheduled(int64_t now) {
+    const int64_t interval = (int64_t)(1e9 / rate_);
+    while (nextDueNs_ <= now && nextDueNs_ < endNs_) {
+      bool sent = false;
+      for (size_t tries = 0; tries < conns_.size(); tries++) {
+        const size_t idx = nextConn_++ % conns_.size();
+        auto &c = conns_[idx];
+        if (!c.connected || c.closeAfter || !c.resend.empty() ||
+            (int)c.inflight.size() >= opts_.pipeline)
+          continue;
+        if (nextDueNs_ >= warmupEndNs_)
+          result.sendLag.record((uint64_t)(nowNs() - nextDueNs_));
+        enqueueRequest(idx, nextDueNs_);
+        flushOut(idx);
+        sent = true;
+        break;
+      }
+      // 所有连接都占满：保留计划时刻，等有响应回来再发，等待时间计入延迟
+      if (!sent)
+        return;
+      nextDueNs_ += interval;
+    }
+  }
+
+  void flushOut(size_t idx) {
+    auto &c = conns_[idx];
+    while (c.outOff < c.out.size()) {
+      const ssize_t n = ::send(c.fd, c.out.data() + c.outOff,
+                               c.out.size() - c.outOff, MSG_NOSIGNAL);
+      if (n > 0) {
+        c.outOff += (size_t)n;
+        continue;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        setWantWrite(idx, true);
+        return;
+      }
+      reconnect(idx, true);
+      return;
+    }
+    c.out.clear();
+    c.outOff = 0;
+    setWantWrite(idx, false);
+  }
+
+  void onWritable(size_t idx) {
+    auto &c = conns_[idx];
+    if (!c.connected) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      ::getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err != 0) {
+        result.errors++;
+        reconnect(idx, false);
+        return;
+      }
+      c.connected = true;
+      setWantWrite(idx, false);
+      fill(idx);
+      return;
+    }
+    flushOut(idx);
+  }
+
+  void onReadable(size_t idx) {
+    auto &c = conns_[idx];
+    char buf[65536];
+    while (c.fd >= 0) {
+      const ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+      if (n > 0) {
+        c.in.append(buf, (size_t)n);
+        if (!parseResponses(idx))
+          return;
+        continue;
+      }
+      if (n == 0) {
+        reconnect(idx, !c.inflight.empty() && !c.closeAfter);
+        return;
+      }
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      reconnect(idx, true);
+      return;
+    }
+    if (c.fd >= 0)
+      fill(idx);
+  }
+
+  static bool headerIs(const std::string &line, const char *name) {
+    const size_t n = std::strlen(name);
+    if (line.size() < n + 1)
+      return false;
+    for (size_t i = 0; i < n; i++) {
+      if (std::tolower((unsigned char)line[i]) != name[i])
+        return false;
+    }
+    return line[n] == ':';
+  }
+
+  // 返回 false 表示连接已被替换
+  bool parseResponses(size_t idx) {
+    auto &c = conns_[idx];
+    while (true) {
+      if (c.haveHead) {
+        const uint64_t avail = c.in.size() - c.inOff;
+        const uint64_t take = std::min(avail, c.bodyRemaining);
+        c.inOff += (size_t)take;
+        c.bodyRemaining -= take;
+        if (c.bodyRemaining > 0)
+          break;
+        c.haveHead = false;
+        if (!complete(idx))
+          return false;
+        continue;
+      }
+      const size_t end = c.in.find("\r\n\r\n", c.inOff);
+      if (end == std::string::npos) {
+        if (c.in.size() - c.inOff > kMaxResponseHead) {
+          reconnect(idx, true);
+          return false;
+        }
+        break;
+      }
+      const std::string head = c.in.substr(c.inOff, end - c.inOff);
+      c.inOff = end + 4;
+      c.status = head.size() > 12 ? std::atoi(head.c_str() + 9) : 0;
+      c.bodyRemaining = 0;
+      size_t pos = head.find("\r\n");
+      while (pos != std::string::npos) {
+        const size_t next = head.find("\r\n", pos + 2);
+        const std::string line = head.substr(
+            pos + 2, next == std::string::npos ? std::string::npos
+                                               : next - pos - 2);
+        if (headerIs(line, "content-length")) {
+          c.bodyRemaining = std::strtoull(line.c_str() + 15, nullptr, 10);
+        } else if (headerIs(line, "connection") &&
+                   line.find("close") != std::string::npos) {
+          c.closeAfter = true;
+        }
+        pos = next;
+      }
+      c.responseBytes = head.size() + 4 + c.bodyRemaining;
+      c.haveHead = true;
+    }
+    if (c.inOff == c.in.size()) {
+      c.in.clear();
+      c.inOff = 0;
+    } else if (c.inOff > 65536) {
+      c.in.erase(0, c.inOff);
+      c.inOff = 0;
+    }
+    return true;
+  }
+
+  bool complete(size_t idx) {
+    auto &c = conns_[idx];
+    const int64_t now = nowNs();
+    if (!c.inflight.empty()) {
+      const int64_t scheduled = c.inflight.front();
+      c.inflight.pop_front();
+      if (scheduled >= warmupEndNs_ && now <= endNs_) {
+        result.latency.record((uint64_t)(now - scheduled));
+        result.requests++;
+        result.bytes += c.responseBytes;
+        const int cls = c.status / 100;
+        result.status[cls >= 1 && cls <= 5 ? cls : 0]++;
+        if (opts_.expectStatus != 0 && c.status != opts_.expectStatus)
+          result.unexpected++;
+      }
+    }
+    if (c.closeAfter) {
+      reconnect(idx, false);
+      return false;
+    }
+    return true;
+  }
+};
+
+static bool resolveHost(const std::string &host, int port, sockaddr_in &out) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *res = nullptr;
+  if (::getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
+    return false;
+  out = *reinterpret_cast<sockaddr_in *>(res->ai_addr);
+  out.sin_port = htons((uint16_t)port);
+  ::freeaddrinfo(res);
+  return true;
+}
+
+static bool runBench(const BenchOptions &opts, BenchResult &total) {
+  sockaddr_in addr{};
+  if (!resolveHost(opts.host, opts.port, addr)) {
+    std::fprintf(stderr, "cannot resolve %s\n", opts.host.c_str());
+    return false;
+  }
+  const int threads = std::max(1, std::min(opts.threads, opts.connections));
+  const int64_t start = nowNs();
+  std::vector<std::unique_ptr<BenchThread>> workers;
+  for (int i = 0; i < threads; i++) {
+    const int conns =
+        opts.connections / threads + (i < opts.connections % threads ? 1 : 0);
+    workers.push_back(std::make_unique<BenchThread>(
+        opts, addr, conns, opts.rate / threads, start, (size_t)i));
+  }
+  std::vector<std::thread> ts;
+  for (auto &w : workers)
+    ts.emplace_back([&w]() { w->run(); });
+  for (auto &t : ts)
+    t.join();
+  for (auto &w : workers) {
+    total.merge(w->result);
+    total.elapsedSec = std::max(total.elapsedSec, w->result.elapsedSec);
+  }
+  return true;
+}
+
+static std::string formatNs(uint64_t ns) {
+  char buf[32];
+  if (ns < 1000000)
+    std::snprintf(buf, sizeof(buf), "%.1fus", (double)ns / 1e3);
+  else if (ns < 1000000000)
+    std::snprintf(buf, sizeof(buf), "%.2fms", (double)ns / 1e6);
+  else
+    std::snprintf(buf, sizeof(buf), "%.2fs", (double)ns / 1e9);
+  return buf;
+}
+
+static void printHeader() {
+  std::printf("%-10s %10s %9s %10s %10s %10s %10s %10s %7s\n", "scenario",
+              "req/s", "MB/s", "p50", "p90", "p99", "p99.9", "max", "errors");
+}
+
+static void printRow(const std::string &name, const BenchResult &r) {
+  const double secs = r.elapsedSec > 0 ? r.elapsedSec : 1;
+  std::printf("%-10s %10.0f %9.1f %10s %10s %10s %10s %10s %7llu\n",
+              name.c_str(), (double)r.requests / secs,
+              (double)r.bytes / secs / (1024.0 * 1024.0),
+              formatNs(r.latency.percentile(50)).c_str(),
+              formatNs(r.latency.percentile(90)).c_str(),
+              formatNs(r.latency.percentile(99)).c_str(),
+              formatNs(r.latency.percentile(99.9)).c_str(),
+              formatNs(r.latency.max()).c_str(),
+              (unsigned long long)(r.errors + r.unexpected));
+  // 开环模式下客户端自身跟不上计划时会体现在这里，与服务端延迟分开看
+  if (r.sendLag.count() > 0) {
+    std::printf("%-10s %10s %9s %10s %10s %10s %10s %10s\n", "  send lag",
+                "", "", formatNs(r.sendLag.percentile(50)).c_str(),
+                formatNs(r.sendLag.percentile(90)).c_str(),
+                formatNs(r.sendLag.percentile(99)).c_str(),
+                formatNs(r.sendLag.percentile(99.9)).c_str(),
+                formatNs(r.sendLag.max()).c_str());
+  }
+}
+
+static void printJson(const std::vector<std::pair<std::string, BenchResult>> &rows) {
+  std::printf("[\n");
+  for (size_t i = 0; i < rows.size(); i++) {
+    const auto &r = rows[i].second;
+    const double secs = r.elapsedSec > 0 ? r.elapsedSec : 1;
+    std::printf(
+        "  {\"scenario\": \"%s\", \"requests\": %llu, \"rps\": %.1f, "
+        "\"bytesPerSec\": %.0f, \"p50Us\": %.1f, \"p90Us\": %.1f, "
+        "\"p99Us\": %.1f, \"p999Us\": %.1f, \"maxUs\": %.1f, "
+        "\"meanUs\": %.1f, \"errors\": %llu, \"unexpectedStatus\": %llu, "
+        "\"reconnects\": %llu, \"sendLagP50Us\": %.1f, "
+        "\"sendLagP99Us\": %.1f, \"sendLagMaxUs\": %.1f}%s\n",
+        rows[i].first.c_str(), (unsigned long long)r.requests,
+        (double)r.requests / secs, (double)r.bytes / secs,
+        (double)r.latency.percentile(50) / 1e3,
+        (double)r.latency.percentile(90) / 1e3,
+        (double)r.latency.percentile(99) / 1e3,
+        (double)r.latency.percentile(99.9) / 1e3,
+        (double)r.latency.max() / 1e3, r.latency.mean() / 1e3,
+        (unsigned long long)r.errors, (unsigned long long)r.unexpected,
+        (unsigned long long)r.reconnects,
+        (double)r.sendLag.percentile(50) / 1e3,
+        (double)r.sendLag.percentile(99) / 1e3,
+        (double)r.sendLag.max() / 1e3, i + 1 < rows.size() ? "," : "");
+  }
+  std::printf("]\n");
+}
+
+struct Scenario {
+  const char *name;
+  const char *path;
+  int expectStatus;
+};
+
+// 404 场景用 /favicon.ico：其他不存在的路径都会走 SPA 回退
+static const Scenario kScenarios[] = {
+    {"small", "/small.txt", 200},
+    {"large", "/large.bin", 200},
+    {"spa", "/app/some/client/route", 200},
+    {"notfound", "/favicon.ico", 404},
+};
+
+static bool writeFile(const std::filesystem::path &p, const std::string &data) {
+  std::ofstream f(p, std::ios::binary);
+  f.write(data.data(), (std::streamsize)data.size());
+  return (bool)f;
+}
+
+static bool portAccepts(int port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons((uint16_t)port);
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return false;
+  const bool ok = ::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+  ::close(fd);
+  return ok;
+}
+
+// 等服务端开始监听；子进程先退出（端口被占、参数错误等）时立即失败，
+// 并在 *exited 里返回它的状态，调用方不必再回收
+static bool waitForPort(pid_t pid, int port, int timeoutMs, bool *exited,
+                        int *status) {
+  *exited = false;
+  for (int waited = 0; waited < timeoutMs; waited += 50) {
+    if (::waitpid(pid, status, WNOHANG) == pid) {
+      *exited = true;
+      return false;
+    }
+    if (portAccepts(port))
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  return false;
+}
+
+static std::filesystem::path defaultServerPath() {
+  std::error_code ec;
+  const auto self = std::filesystem::read_symlink("/proc/self/exe", ec);
+  if (ec)
+    return "mini_next_serve";
+  return self.parent_path() / "mini_next_serve";
+}
+
+static std::vector<std::string> splitArgs(const std::string &s) {
+  std::vector<std::string> out;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    while (pos < s.size() && s[pos] == ' ')
+      pos++;
+    const size_t end = s.find(' ', pos);
+    if (pos < s.size())
+      out.push_back(s.substr(pos, end == std::string::npos ? end : end - pos));
+    pos = end == std::string::npos ? s.size() : end;
+  }
+  return out;
+}
+
+static int runScenarios(BenchOptions base, const std::string &server,
+                        const std::string &serverArgs, bool json) {
+  char tmpl[] = "/tmp/mini-next-bench-XXXXXX";
+  if (!::mkdtemp(tmpl)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  const std::filesystem::path dir = tmpl;
+  // 端口上已经有别的服务时，后面的就绪检查会误把它当成刚启动的服务端
+  if (portAccepts(base.port)) {
+    std::fprintf(stderr, "port %d is already in use; pass --port\n",
+                 base.port);
+    std::filesystem::remove_all(dir);
+    return 1;
+  }
+  writeFile(dir / "index.html",
+            "<!doctype html><html><body><div id=\"root\"></div></body></html>");
+  writeFile(dir / "small.txt", std::string(2048, 's'));
+  writeFile(dir / "large.bin", std::string(1024 * 1024, 'L'));
+
+  std::vector<std::string> args = {server, "--dir", dir.string(), "--port",
+                                   std::to_string(base.port)};
+  for (auto &a : splitArgs(serverArgs))
+    args.push_back(a);
+
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    std::vector<char *> argv;
+    for (auto &a : args)
+      argv.push_back(a.data());
+    argv.push_back(nullptr);
+    const int devnull = ::open("/dev/null", O_WRONLY);
+    if (devnull >= 0)
+      ::dup2(devnull, STDOUT_FILENO);
+    ::execv(argv[0], argv.data());
+    std::perror("execv");
+    std::_Exit(127);
+  }
+  if (pid < 0) {
+    std::perror("fork");
+    std::filesystem::remove_all(dir);
+    return 1;
+  }
+
+  int code = 0;
+  bool exited = false;
+  int status = 0;
+  if (!waitForPort(pid, base.port, 10000, &exited, &status)) {
+    if (exited && WIFEXITED(status))
+      std::fprintf(stderr, "server exited with code %d: %s\n",
+                   WEXITSTATUS(status), server.c_str());
+    else if (exited)
+      std::fprintf(stderr, "server killed by signal %d: %s\n",
+                   WTERMSIG(status), server.c_str());
+    else
+      std::fprintf(stderr, "server did not start: %s\n", server.c_str());
+    code = 1;
+  } else {
+    std::vector<std::pair<std::string, BenchResult>> rows;
+    if (!json)
+      printHeader();
+    for (const auto &sc : kScenarios) {
+      BenchOptions opts = base;
+      opts.host = "127.0.0.1";
+      opts.paths = {sc.path};
+      opts.expectStatus = sc.expectStatus;
+      BenchResult r;
+      if (!runBench(opts, r)) {
+        code = 1;
+        break;
+      }
+      if (!json) {
+        printRow(sc.name, r);
+        std::fflush(stdout);
+      }
+      if (r.errors + r.unexpected > 0)
+        code = 2;
+      rows.emplace_back(sc.name, std::move(r));
+    }
+    if (json)
+      printJson(rows);
+  }
+
+  if (!exited) {
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, &status, 0);
+  }
+  std::filesystem::remove_all(dir);
+  return code;
+}
+
+// 解析 http://host:port/path；只支持明文 HTTP
+static bool parseUrl(const std::string &url, BenchOptions &opts) {
+  std::string rest = url;
+  if (rest.rfind("http://", 0) == 0)
+    rest = rest.substr(7);
+  const size_t slash = rest.find('/');
+  const std::string hostPort = rest.substr(0, slash);
+  const std::string path = slash == std::string::npos ? "/" : rest.substr(slash);
+  const size_t colon = hostPort.rfind(':');
+  if (colon != std::string::npos) {
+    opts.host = hostPort.substr(0, colon);
+    opts.port = std::atoi(hostPort.c_str() + colon + 1);
+  } else {
+    opts.host = hostPort;
+    opts.port = 80;
+  }
+  if (opts.host.empty() || opts.port <= 0 || opts.port > 65535)
+    return false;
+  opts.paths.push_back(path);
+  return true;
+}
+
+static void usage() {
+  std::fprintf(
+      stdout,
+      "Usage: mini_next_bench [options] <url> [<url>...]\n"
+      "       mini_next_bench --scenarios [--server <path>] "
+      "[--server-args \"...\"] [options]\n"
+      "\n"
+      "  -c, --connections <n>  concurrent connections (default 64)\n"
+      "  -t, --threads <n>      client threads (default 2)\n"
+      "  -d, --duration <sec>   measured duration (default 10)\n"
+      "  -w, --warmup <sec>     warmup, not recorded (default 1)\n"
+      "  -p, --pipeline <n>     requests in flight per connection (default 1)\n"
+      "  -R, --rate <req/s>     open-loop fixed rate (default: closed loop)\n"
+      "  --port <port>          port for --scenarios (default 3917)\n"
+      "  --json                 print results as JSON\n");
+}
+
+int main(int argc, char **argv) {
+  BenchOptions opts;
+  bool scenarios = false;
+  bool json = false;
+  std::string server;
+  std::string serverArgs;
+  int scenarioPort = 3917;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string a = argv[i];
+    const bool hasNext = i + 1 < argc;
+    if ((a == "-c" || a == "--connections") && hasNext) {
+      opts.connections = std::max(1, std::atoi(argv[++i]));
+    } else if ((a == "-t" || a == "--threads") && hasNext) {
+      opts.threads = std::max(1, std::atoi(argv[++i]));
+    } else if ((a == "-d" || a == "--duration") && hasNext) {
+      opts.durationSec = std::max(0.1, std::atof(argv[++i]));
+    } else if ((a == "-w" || a == "--warmup") && hasNext) {
+      opts.warmupSec = std::max(0.0, std::atof(argv[++i]));
+    } else if ((a == "-p" || a == "--pipeline") && hasNext) {
+      opts.pipeline = std::max(1, std::atoi(argv[++i]));
+    } else if ((a == "-R" || a == "--rate") && hasNext) {
+      opts.rate = std::max(0.0, std::atof(argv[++i]));
+    } else if (a == "--port" && hasNext) {
+      scenarioPort = std::atoi(argv[++i]);
+    } else if (a == "--scenarios") {
+      scenarios = true;
+    } else if (a == "--server" && hasNext) {
+      server = argv[++i];
+    } else if (a == "--server-args" && hasNext) {
+      serverArgs = argv[++i];
+    } else if (a == "--json") {
+      json = true;
+    } else if (a == "-h" || a == "--help") {
+      usage();
+      return 0;
+    } else if (!a.empty() && a[0] != '-') {
+      if (!parseUrl(a, opts)) {
+        std::fprintf(stderr, "invalid url: %s\n", a.c_str());
+        return 1;
+      }
+    } else {
+      std::fprintf(stderr, "unknown option: %s\n", a.c_str());
+      usage();
+      return 1;
+    }
+  }
+
+  ::signal(SIGPIPE, SIG_IGN);
+
+  if (scenarios) {
+    opts.port = scenarioPort;
+    return runScenarios(opts,
+                        server.empty() ? defaultServerPath().string() : server,
+                        serverArgs, json);
+  }
+
+  if (opts.paths.empty()) {
+    usage();
+    return 1;
+  }
+  BenchResult r;
+  if (!runBench(opts, r))
+    return 1;
+  if (json) {
+    printJson({{"custom", std::move(r)}});
+  } else {
+    printHeader();
+    printRow("custom", r);
+    std::printf("status: 2xx=%llu 3xx=%llu 4xx=%llu 5xx=%llu other=%llu, "
+                "reconnects=%llu\n",
+                (unsigned long long)r.status[2],
+                (unsigned long long)r.status[3],
+                (unsigned long long)r.status[4],
+                (unsigned long long)r.status[5],
+                (unsigned long long)r.status[0],
+                (unsigned long long)r.reconnects);
+  }
+  return r.requests == 0 && r.errors > 0 ? 2 : 0;
+}
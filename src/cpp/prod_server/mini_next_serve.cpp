@@ -1,15 +1,50 @@
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef IORING_FEAT_FAST_POLL
+#define MINI_NEXT_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <csignal>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
 #include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <initializer_list>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -61,14 +96,118 @@ static std::string guessContentType(const std::string &path) {
   return "application/octet-stream";
 }
 
-static bool readFile(const std::filesystem::path &p, std::string &out) {
-  std::ifstream f(p, std::ios::binary);
-  if (!f)
+static bool isCompressible(const std::string &contentType) {
+  return startsWith(contentType, "text/") ||
+         contentType.find("javascript") != std::string::npos ||
+         contentType.find("json") != std::string::npos ||
+         contentType.find("svg+xml") != std::string::npos;
+}
+
+static bool gzipCompress(std::string_view in, std::string &out) {
+  z_stream zs{};
+  if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
     return false;
-  std::ostringstream ss;
-  ss << f.rdbuf();
-  out = ss.str();
-  return true;
+  out.resize(deflateBound(&zs, (uLong)in.size()));
+  zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  zs.avail_in = (uInt)in.size();
+  zs.next_out = reinterpret_cast<Bytef *>(out.data());
+  zs.avail_out = (uInt)out.size();
+  const int rc = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return rc == Z_STREAM_END;
+}
+
+struct AcceptEncoding {
+  bool gzip = false;
+  bool br = false;
+};
+
+// 解析 Accept-Encoding，忽略 q=0 的编码；"*" 同时接受 gzip 与 br
+static AcceptEncoding parseAcceptEncoding(const std::string *header) {
+  AcceptEncoding out;
+  if (!header)
+    return out;
+  const std::string h = toLower(*header);
+  size_t pos = 0;
+  while (pos <= h.size()) {
+    size_t comma = h.find(',', pos);
+    if (comma == std::string::npos)
+      comma = h.size();
+    std::string item = h.substr(pos, comma - pos);
+    pos = comma + 1;
+
+    bool rejected = false;
+    const auto semi = item.find(';');
+    if (semi != std::string::npos) {
+      const auto q = item.find("q=", semi);
+      if (q != std::string::npos && std::strtod(item.c_str() + q + 2,
+                                                nullptr) <= 0.0)
+        rejected = true;
+      item.resize(semi);
+    }
+    size_t b = 0;
+    size_t e = item.size();
+    while (b < e && (item[b] == ' ' || item[b] == '\t'))
+      b++;
+    while (e > b && (item[e - 1] == ' ' || item[e - 1] == '\t'))
+      e--;
+    const auto coding = item.substr(b, e - b);
+    if (coding == "gzip" || coding == "*")
+      out.gzip = !rejected;
+    if (coding == "br" || coding == "*")
+      out.br = !rejected;
+  }
+  return out;
+}
+
+class UniqueFd {
+public:
+  UniqueFd() = default;
+  explicit UniqueFd(int fd) : fd_(fd) {}
+  ~UniqueFd() { reset(); }
+
+  UniqueFd(UniqueFd &&o) noexcept : fd_(o.fd_) { o.fd_ = -1; }
+  UniqueFd &operator=(UniqueFd &&o) noexcept {
+    if (this != &o) {
+      reset();
+      fd_ = o.fd_;
+      o.fd_ = -1;
+    }
+    return *this;
+  }
+  UniqueFd(const UniqueFd &) = delete;
+  UniqueFd &operator=(const UniqueFd &) = delete;
+
+  int get() const { return fd_; }
+  explicit operator bool() const { return fd_ >= 0; }
+  void reset() {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+  }
+
+private:
+  int fd_{-1};
+};
+
+enum class OpenResult { Ok, NotFound, Directory };
+
+// 打开普通文件并取得元数据；一次 open + fstat 代替 exists/is_regular_file 检查
+static OpenResult openRegularFile(const std::filesystem::path &p, UniqueFd &out,
+                                  struct stat &st) {
+  UniqueFd fd(::open(p.c_str(), O_RDONLY | O_CLOEXEC));
+  if (!fd)
+    return OpenResult::NotFound;
+  if (::fstat(fd.get(), &st) != 0)
+    return OpenResult::NotFound;
+  if (S_ISDIR(st.st_mode))
+    return OpenResult::Directory;
+  if (!S_ISREG(st.st_mode))
+    return OpenResult::NotFound;
+  out = std::move(fd);
+  return OpenResult::Ok;
 }
 
 static std::string urlDecode(const std::string &s) {
@@ -111,170 +250,2844 @@ static std::string sanitizePath(const std::string &raw) {
   return p;
 }
 
-static std::string buildResponse(int status, const std::string &statusText,
-                                 const std::string &contentType,
-                                 const std::string &body) {
-  std::ostringstream ss;
-  ss << "HTTP/1.1 " << status << " " << statusText << "\r\n";
-  ss << "content-type: " << contentType << "\r\n";
-  ss << "content-length: " << body.size() << "\r\n";
-  ss << "connection: close\r\n";
-  ss << "\r\n";
-  ss << body;
-  return ss.str();
-}
-
-static void handleClient(int fd, const std::filesystem::path &rootDir,
-                         const std::filesystem::path &publicDir) {
-  std::string req;
-  req.resize(8192);
-  const ssize_t n = ::read(fd, req.data(), req.size());
-  if (n <= 0) {
-    ::close(fd);
-    return;
+static std::string httpDate(time_t t) {
+  std::tm tm{};
+  ::gmtime_r(&t, &tm);
+  char buf[64];
+  const size_t n =
+      std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return std::string(buf, n);
+}
+
+static bool parseHttpDate(const std::string &s, time_t &out) {
+  std::tm tm{};
+  const char *end = ::strptime(s.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (!end)
+    return false;
+  out = ::timegm(&tm);
+  return true;
+}
+
+static uint64_t fnv1a64(uint64_t h, const char *data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ULL;
   }
-  req.resize((size_t)n);
+  return h;
+}
 
-  std::istringstream in(req);
-  std::string method;
-  std::string target;
-  std::string version;
-  in >> method >> target >> version;
+static constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
 
-  if (method != "GET" && method != "HEAD") {
-    const auto resp =
-        buildResponse(405, "Method Not Allowed", "text/plain; charset=utf-8",
-                      "Method Not Allowed");
-    ::write(fd, resp.data(), resp.size());
-    ::close(fd);
-    return;
+static std::string quotedHex(uint64_t v) {
+  char buf[24];
+  std::snprintf(buf, sizeof(buf), "\"%016llx\"", (unsigned long long)v);
+  return buf;
+}
+
+// 强 ETag：内容哈希。fd 版本分块读取，不需要把整个文件放进内存
+static bool contentEtag(int fd, off_t size, std::string &out) {
+  std::vector<char> buf(64 * 1024);
+  uint64_t h = kFnvOffset;
+  off_t off = 0;
+  while (off < size) {
+    const ssize_t n = ::pread(fd, buf.data(), buf.size(), off);
+    if (n <= 0)
+      return false;
+    h = fnv1a64(h, buf.data(), (size_t)n);
+    off += n;
   }
+  out = quotedHex(h);
+  return true;
+}
 
-  const auto clean = sanitizePath(target);
-  std::filesystem::path candidate;
-  bool fromPublic = false;
-  if (startsWith(clean, "/public/")) {
-    candidate = publicDir / clean.substr(std::string("/public/").size());
-    fromPublic = true;
-  } else {
-    candidate = rootDir / clean.substr(1);
+static std::string contentEtag(std::string_view data) {
+  return quotedHex(fnv1a64(kFnvOffset, data.data(), data.size()));
+}
+
+// 由 mtime 与大小构成的 ETag，不需要读取内容：未启用缓存时，以及缓存里
+// 只保存元数据的文件使用
+static std::string statEtag(const struct stat &st) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "\"%llx-%llx\"",
+                (unsigned long long)st.st_mtim.tv_sec,
+                (unsigned long long)st.st_size);
+  return buf;
+}
+
+// 文件名中出现 8 位以上且含数字的字母数字片段（如 app.3f9a8c1b.js、
+// chunk-5KX2A9QZ.js）视为内容哈希，可以永久缓存
+static bool isHashedFilename(const std::string &urlPath) {
+  const auto slash = urlPath.rfind('/');
+  const std::string name =
+      slash == std::string::npos ? urlPath : urlPath.substr(slash + 1);
+  size_t i = 0;
+  while (i < name.size()) {
+    size_t j = i;
+    bool digit = false;
+    while (j < name.size() && name[j] != '.' && name[j] != '-' &&
+           name[j] != '_') {
+      const char c = name[j];
+      if (c >= '0' && c <= '9')
+        digit = true;
+      else if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        break;
+      j++;
+    }
+    const bool tokenEnd =
+        j == name.size() || name[j] == '.' || name[j] == '-' || name[j] == '_';
+    if (tokenEnd && j - i >= 8 && digit && j < name.size())
+      return true;
+    while (j < name.size() && name[j] != '.' && name[j] != '-' &&
+           name[j] != '_')
+      j++;
+    i = j + 1;
   }
+  return false;
+}
 
-  if (std::filesystem::is_directory(candidate)) {
-    candidate = candidate / "index.html";
+// 只支持 '*' 通配任意字符序列
+static bool globMatch(const char *pat, const char *s) {
+  while (*pat) {
+    if (*pat == '*') {
+      pat++;
+      if (!*pat)
+        return true;
+      for (; *s; s++) {
+        if (globMatch(pat, s))
+          return true;
+      }
+      return false;
+    }
+    if (*pat != *s)
+      return false;
+    pat++;
+    s++;
+  }
+  return *s == '\0';
+}
+
+struct CacheControlRule {
+  std::string pattern;
+  std::string value;
+};
+
+// Cache-Control 策略：--cache-control 规则按顺序匹配 URL 路径，先匹配先用；
+// 都不匹配时 HTML 用 no-cache（配合 ETag 重新验证），/public/ 下带哈希的
+// 文件名为 immutable，其余缓存一小时
+struct CacheControlPolicy {
+  std::vector<CacheControlRule> rules;
+
+  std::string lookup(const std::string &urlPath,
+                     const std::string &contentType) const {
+    for (const auto &r : rules) {
+      if (globMatch(r.pattern.c_str(), urlPath.c_str()))
+        return r.value;
+    }
+    if (startsWith(contentType, "text/html"))
+      return "no-cache";
+    if (startsWith(urlPath, "/public/") && isHashedFilename(urlPath))
+      return "public, max-age=31536000, immutable";
+    return "public, max-age=3600";
   }
+};
+
+// 缓存的静态文件：小文件内容常驻内存，大文件保留打开的 fd 走 sendfile；
+// 超出预算或 fd 上限的文件只缓存元数据（ETag 取 mtime 与大小），命中时再按
+// 路径打开。
+struct CachedFile {
+  std::filesystem::path path;
+  std::string contentType;
+  off_t size = 0;
+  timespec mtime{};
+  std::string etag;
+  std::string lastModified;
+  size_t charge = 0;
+  bool inMemory = false;
+  std::string data;
+  UniqueFd fd;
+};
 
+using CachedFilePtr = std::shared_ptr<const CachedFile>;
+
+// 同一资源的各编码版本：磁盘上的 .br/.gz 兄弟文件，或启动时在内存中
+// 生成的 gzip 版本（--precompress）
+struct CacheEntry {
+  CachedFilePtr file;
+  CachedFilePtr gzip;
+  CachedFilePtr br;
+  std::string cacheControl;
+};
+
+// 只读快照：URL 路径（sanitizePath 之后）-> 文件。目录的 "/dir" 与
+// "/dir/" 都指向其 index.html，fallback 是根目录的 index.html。
+struct CacheSnapshot {
+  std::unordered_map<std::string, CacheEntry> byUrl;
+  CacheEntry fallback;
+};
+
+// 响应 = 内存中的 head/body + 可选的文件区间（通过 sendfile 发送）。
+// body 可以直接引用缓存条目的内容，不做拷贝。
+// 输出队列里的一段：内存数据（head + body）之后跟一个可选的文件区间。
+// multipart/byteranges 响应由多段组成，后续段放在 parts 里，入队时展开
+struct Response {
+  std::string head;
   std::string body;
-  if (!std::filesystem::exists(candidate) ||
-      !std::filesystem::is_regular_file(candidate) ||
-      !readFile(candidate, body)) {
-    std::string fallback;
-    const auto fallbackIndex = rootDir / "index.html";
-    if (readFile(fallbackIndex, fallback) && clean != "/favicon.ico") {
-      const auto resp = buildResponse(200, "OK", "text/html; charset=utf-8",
-                                      method == "HEAD" ? "" : fallback);
-      ::write(fd, resp.data(), resp.size());
-      ::close(fd);
-      return;
-    }
-    const auto resp = buildResponse(404, "Not Found",
-                                    "text/plain; charset=utf-8", "Not Found");
-    ::write(fd, resp.data(), resp.size());
-    ::close(fd);
-    return;
+  CachedFilePtr cached;
+  bool cachedBody = false;
+  size_t cachedOff = 0;
+  size_t cachedLen = 0;
+  UniqueFd ownedFile;
+  int fileFd = -1;
+  off_t fileOffset = 0;
+  off_t fileEnd = 0;
+  size_t memOff = 0;
+  std::vector<Response> parts;
+
+  std::string_view bodyView() const {
+    if (cachedBody)
+      return std::string_view(cached->data).substr(cachedOff, cachedLen);
+    return std::string_view(body);
   }
+  size_t memSize() const { return head.size() + bodyView().size(); }
+  bool done() const { return memOff >= memSize() && fileOffset >= fileEnd; }
+};
 
-  const auto ct = guessContentType(candidate.string());
-  const auto resp = buildResponse(200, "OK", ct, method == "HEAD" ? "" : body);
-  ::write(fd, resp.data(), resp.size());
-  ::close(fd);
-  (void)fromPublic;
+// extraHeaders 为预先格式化好的 "name: value\r\n" 行
+static std::string buildHead(int status, const std::string &statusText,
+                             const std::string &contentType,
+                             size_t contentLength, bool keepAlive,
+                             const std::string &extraHeaders = std::string()) {
+  std::string out;
+  out.reserve(128 + extraHeaders.size());
+  out.append("HTTP/1.1 ");
+  out.append(std::to_string(status));
+  out.push_back(' ');
+  out.append(statusText);
+  out.append("\r\ncontent-type: ");
+  out.append(contentType);
+  out.append("\r\ncontent-length: ");
+  out.append(std::to_string(contentLength));
+  out.append("\r\n");
+  out.append(extraHeaders);
+  out.append(keepAlive ? "connection: keep-alive\r\n\r\n"
+                       : "connection: close\r\n\r\n");
+  return out;
 }
 
-static int parsePort(const char *s) {
-  if (!s)
-    return 3000;
-  char *end = nullptr;
-  const long v = std::strtol(s, &end, 10);
-  if (!end || *end != '\0')
-    return 3000;
-  if (v <= 0 || v > 65535)
-    return 3000;
-  return (int)v;
+static Response buildResponse(int status, const std::string &statusText,
+                              const std::string &contentType,
+                              const std::string &body, bool keepAlive,
+                              bool headOnly) {
+  Response r;
+  r.head = buildHead(status, statusText, contentType, body.size(), keepAlive);
+  if (!headOnly)
+    r.body = body;
+  return r;
 }
 
-int main(int argc, char **argv) {
-  std::filesystem::path dir = std::filesystem::current_path();
-  int port = 3000;
+static constexpr size_t kInlineFileMax = 64 * 1024;
+static constexpr size_t kInotifyBufSize = 64 * 1024;
 
-  for (int i = 1; i < argc; i++) {
-    const std::string a = argv[i] ? std::string(argv[i]) : std::string();
-    if (a == "--dir" && i + 1 < argc) {
-      dir = std::filesystem::path(argv[++i]);
-      continue;
+// 缓存最多常驻的大文件 fd：RLIMIT_NOFILE 软限制的四分之一，其余留给连接
+static size_t heldFdLimit() {
+  rlimit rl{};
+  if (::getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY)
+    return 4096;
+  return (size_t)rl.rlim_cur / 4;
+}
+
+// 启动时预加载 --dir 下的全部文件（内容受 budget 限制，元数据总是完整），
+// 之后由 inotify 精确地重载/删除变化的文件并发布新快照。
+// 快照不跟随符号链接目录；未命中时请求处理仍会查一次文件系统，再决定 SPA 回退。
+class StaticCache {
+public:
+  StaticCache(std::filesystem::path rootDir, size_t budgetBytes,
+              bool precompress, const CacheControlPolicy &cacheControl)
+      : rootDir_(std::move(rootDir)), budget_(budgetBytes),
+        maxHeldFds_(heldFdLimit()), precompress_(precompress),
+        cacheControl_(cacheControl) {}
+
+  ~StaticCache() { stop(); }
+
+  StaticCache(const StaticCache &) = delete;
+  StaticCache &operator=(const StaticCache &) = delete;
+
+  bool start() {
+    inotifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+      std::perror("inotify_init1");
+      return false;
     }
-    if (a == "--port" && i + 1 < argc) {
-      port = parsePort(argv[++i]);
-      continue;
+    stopFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd_ < 0) {
+      std::perror("eventfd");
+      return false;
     }
-    if (a == "-h" || a == "--help") {
-      std::fprintf(stdout,
-                   "Usage: mini-next-serve --dir <staticDir> --port <port>\n");
-      std::fflush(stdout);
-      return 0;
+    addTree("");
+    publish();
+    thread_ = std::thread([this]() { loop(); });
+    return true;
+  }
+
+  void stop() {
+    if (thread_.joinable()) {
+      const uint64_t one = 1;
+      (void)!::write(stopFd_, &one, sizeof(one));
+      thread_.join();
     }
+    if (inotifyFd_ >= 0)
+      ::close(inotifyFd_);
+    if (stopFd_ >= 0)
+      ::close(stopFd_);
+    inotifyFd_ = -1;
+    stopFd_ = -1;
   }
 
-  const auto rootDir = std::filesystem::absolute(dir);
-  const auto publicDir = rootDir / "public";
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
 
-  const int serverFd = ::socket(AF_INET, SOCK_STREAM, 0);
-  if (serverFd < 0) {
-    std::perror("socket");
-    return 2;
+  std::shared_ptr<const CacheSnapshot> snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snap_;
   }
 
-  int opt = 1;
-  ::setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  size_t fileCount() const { return fileCount_.load(); }
+  size_t bytes() const { return bytesPublished_.load(); }
 
-  sockaddr_in addr{};
-  addr.sin_family = AF_INET;
-  addr.sin_addr.s_addr = htonl(INADDR_ANY);
-  addr.sin_port = htons((uint16_t)port);
+private:
+  std::filesystem::path rootDir_;
+  size_t budget_;
+  size_t maxHeldFds_;
+  bool precompress_;
+  const CacheControlPolicy &cacheControl_;
+  size_t bytes_ = 0;
+  size_t heldFds_ = 0;
+  std::map<std::string, CachedFilePtr> files_;
+  std::unordered_map<std::string, CachedFilePtr> gzipped_;
+  std::unordered_map<int, std::string> watches_;
+  int inotifyFd_ = -1;
+  int stopFd_ = -1;
+  std::thread thread_;
 
-  if (::bind(serverFd, (sockaddr *)&addr, sizeof(addr)) != 0) {
-    std::perror("bind");
-    ::close(serverFd);
-    return 3;
+  mutable std::mutex mutex_;
+  std::shared_ptr<const CacheSnapshot> snap_;
+  std::atomic<uint64_t> version_{0};
+  std::atomic<size_t> fileCount_{0};
+  std::atomic<size_t> bytesPublished_{0};
+
+  static std::string joinRel(const std::string &dir, const std::string &name) {
+    return dir.empty() ? name : dir + "/" + name;
   }
 
-  if (::listen(serverFd, 128) != 0) {
-    std::perror("listen");
-    ::close(serverFd);
-    return 4;
+  void addTree(const std::string &relDir) {
+    const auto abs = relDir.empty() ? rootDir_ : rootDir_ / relDir;
+    const int wd = ::inotify_add_watch(
+        inotifyFd_, abs.c_str(),
+        IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+            IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR);
+    if (wd >= 0)
+      watches_[wd] = relDir;
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(abs, ec), end;
+         !ec && it != end; it.increment(ec)) {
+      const auto name = it->path().filename().string();
+      const auto rel = joinRel(relDir, name);
+      std::error_code sec;
+      if (it->is_directory(sec) && !it->is_symlink(sec)) {
+        addTree(rel);
+      } else if (it->is_regular_file(sec)) {
+        loadFile(rel);
+      }
+    }
   }
 
-  std::fprintf(stdout, "mini-next-serve listening on http://localhost:%d\n",
-               port);
-  std::fprintf(stdout, "dir: %s\n", rootDir.string().c_str());
-  std::fflush(stdout);
+  void unwatchTree(const std::string &relDir) {
+    for (auto it = watches_.begin(); it != watches_.end();) {
+      if (it->second == relDir || it->second.rfind(relDir + "/", 0) == 0) {
+        ::inotify_rm_watch(inotifyFd_, it->first);
+        it = watches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
 
-  while (true) {
-    sockaddr_in client{};
-    socklen_t len = sizeof(client);
-    const int fd = ::accept(serverFd, (sockaddr *)&client, &len);
-    if (fd < 0) {
-      if (errno == EINTR)
+  void removeTree(const std::string &relDir) {
+    const std::string prefix = relDir + "/";
+    for (auto it = files_.lower_bound(prefix);
+         it != files_.end() && it->first.rfind(prefix, 0) == 0;) {
+      dropGzip(it->first);
+      release(*it->second);
+      it = files_.erase(it);
+    }
+  }
+
+  void dropGzip(const std::string &rel) {
+    auto it = gzipped_.find(rel);
+    if (it == gzipped_.end())
+      return;
+    bytes_ -= it->second->charge;
+    gzipped_.erase(it);
+  }
+
+  void release(const CachedFile &f) {
+    bytes_ -= f.charge;
+    if (f.fd)
+      heldFds_--;
+  }
+
+  void removeFile(const std::string &rel) {
+    dropGzip(rel);
+    auto it = files_.find(rel);
+    if (it == files_.end())
+      return;
+    release(*it->second);
+    files_.erase(it);
+  }
+
+  // 为文本类文件生成内存中的 gzip 版本；压缩后没有明显变小则不保留
+  void buildGzip(const std::string &rel, const CachedFile &f, int fd) {
+    if (!precompress_ || !isCompressible(f.contentType) || f.size < 256)
+      return;
+    std::string raw;
+    std::string_view src;
+    if (f.inMemory) {
+      src = f.data;
+    } else {
+      raw.resize((size_t)f.size);
+      size_t off = 0;
+      while (off < raw.size()) {
+        const ssize_t n =
+            ::pread(fd, raw.data() + off, raw.size() - off, (off_t)off);
+        if (n <= 0)
+          return;
+        off += (size_t)n;
+      }
+      src = raw;
+    }
+    auto gz = std::make_shared<CachedFile>();
+    if (!gzipCompress(src, gz->data) ||
+        gz->data.size() + gz->data.size() / 8 >= src.size())
+      return;
+    if (bytes_ + gz->data.size() > budget_)
+      return;
+    gz->path = f.path;
+    gz->contentType = f.contentType;
+    gz->size = (off_t)gz->data.size();
+    gz->mtime = f.mtime;
+    gz->etag = contentEtag(gz->data);
+    gz->lastModified = f.lastModified;
+    gz->inMemory = true;
+    gz->charge = gz->data.size();
+    bytes_ += gz->charge;
+    gzipped_[rel] = std::move(gz);
+  }
+
+  void loadFile(const std::string &rel) {
+    removeFile(rel);
+
+    auto f = std::make_shared<CachedFile>();
+    f->path = rootDir_ / rel;
+    UniqueFd fd(::open(f->path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+      return;
+    struct stat st {};
+    if (::fstat(fd.get(), &st) != 0 || !S_ISREG(st.st_mode))
+      return;
+    f->contentType = guessContentType(rel);
+    f->size = st.st_size;
+    f->mtime = st.st_mtim;
+    f->lastModified = httpDate(st.st_mtim.tv_sec);
+
+    // 只有预算内的内容才读取并计算内容哈希，启动和重载读取的字节数不超过预算
+    const size_t size = (size_t)st.st_size;
+    const bool inBudget = bytes_ + size <= budget_;
+    if (inBudget && size <= kInlineFileMax) {
+      f->data.resize(size);
+      size_t off = 0;
+      while (off < size) {
+        const ssize_t n =
+            ::pread(fd.get(), f->data.data() + off, size - off, (off_t)off);
+        if (n <= 0)
+          break;
+        off += (size_t)n;
+      }
+      if (off != size)
+        return;
+      f->inMemory = true;
+      f->etag = contentEtag(f->data);
+    } else if (inBudget && heldFds_ < maxHeldFds_) {
+      if (!contentEtag(fd.get(), st.st_size, f->etag))
+        return;
+      f->fd = std::move(fd);
+      heldFds_++;
+    } else {
+      f->etag = statEtag(st);
+    }
+    if (f->inMemory || f->fd) {
+      f->charge = size;
+      bytes_ += size;
+      buildGzip(rel, *f, fd ? fd.get() : f->fd.get());
+    }
+    files_[rel] = std::move(f);
+  }
+
+  void publish() {
+    auto snap = std::make_shared<CacheSnapshot>();
+    snap->byUrl.reserve(files_.size() + 16);
+    for (const auto &kv : files_) {
+      const std::string &rel = kv.first;
+      CacheEntry entry;
+      entry.file = kv.second;
+      if (isCompressible(kv.second->contentType)) {
+        const auto br = files_.find(rel + ".br");
+        if (br != files_.end())
+          entry.br = br->second;
+        const auto gz = files_.find(rel + ".gz");
+        if (gz != files_.end()) {
+          entry.gzip = gz->second;
+        } else {
+          const auto mem = gzipped_.find(rel);
+          if (mem != gzipped_.end())
+            entry.gzip = mem->second;
+        }
+      }
+
+      const auto &ct = kv.second->contentType;
+      const auto addKey = [&](const std::string &url) {
+        entry.cacheControl = cacheControl_.lookup(url, ct);
+        snap->byUrl[url] = entry;
+      };
+      addKey("/" + rel);
+      if (rel == "index.html") {
+        addKey("/");
+        snap->fallback = entry;
+      } else if (rel.size() > 11 &&
+                 rel.compare(rel.size() - 11, 11, "/index.html") == 0) {
+        const auto dir = rel.substr(0, rel.size() - 11);
+        addKey("/" + dir);
+        addKey("/" + dir + "/");
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      snap_ = std::move(snap);
+    }
+    fileCount_.store(files_.size());
+    bytesPublished_.store(bytes_);
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  void rebuild() {
+    for (const auto &kv : watches_)
+      ::inotify_rm_watch(inotifyFd_, kv.first);
+    watches_.clear();
+    files_.clear();
+    gzipped_.clear();
+    bytes_ = 0;
+    heldFds_ = 0;
+    addTree("");
+  }
+
+  void loop() {
+    std::vector<char> buf(kInotifyBufSize);
+    pollfd fds[2];
+    fds[0].fd = inotifyFd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopFd_;
+    fds[1].events = POLLIN;
+    while (true) {
+      const int n = ::poll(fds, 2, -1);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      if (fds[1].revents)
+        return;
+      if (!(fds[0].revents & POLLIN))
         continue;
-      std::perror("accept");
-      break;
+
+      // 同一批事件里对同一文件的多次修改只重载一次；true = 重载，false = 删除
+      std::map<std::string, bool> pending;
+      bool changed = false;
+      while (true) {
+        const ssize_t len = ::read(inotifyFd_, buf.data(), buf.size());
+        if (len <= 0)
+          break;
+        for (ssize_t off = 0; off < len;) {
+          const auto *ev = reinterpret_cast<const inotify_event *>(&buf[off]);
+          off += (ssize_t)(sizeof(inotify_event) + ev->len);
+          changed = true;
+          if (ev->mask & IN_Q_OVERFLOW) {
+            rebuild();
+            continue;
+          }
+          if (ev->mask & IN_IGNORED) {
+            watches_.erase(ev->wd);
+            continue;
+          }
+          const auto w = watches_.find(ev->wd);
+          if (w == watches_.end() || ev->len == 0)
+            continue;
+          const auto rel = joinRel(w->second, ev->name);
+          if (ev->mask & IN_ISDIR) {
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+              unwatchTree(rel);
+              removeTree(rel);
+            } else if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+              addTree(rel);
+            }
+            continue;
+          }
+          pending[rel] = !(ev->mask & (IN_DELETE | IN_MOVED_FROM));
+        }
+      }
+      for (const auto &kv : pending) {
+        if (kv.second) {
+          loadFile(kv.first);
+        } else {
+          removeFile(kv.first);
+        }
+      }
+      if (changed)
+        publish();
+    }
+  }
+};
+
+struct ServeContext {
+  std::filesystem::path rootDir;
+  std::filesystem::path publicDir;
+  int keepAliveTimeoutSec = 15;
+  int maxRequestsPerConnection = 1000;
+  int drainTimeoutSec = 30;
+  CacheControlPolicy cacheControl;
+  StaticCache *cache = nullptr;
+};
+
+struct HttpRequest {
+  std::string method;
+  std::string target;
+  std::string version;
+  std::vector<std::pair<std::string, std::string>> headers;
+  bool keepAlive = false;
+
+  const std::string *header(const std::string &lowerName) const {
+    for (const auto &kv : headers) {
+      if (kv.first == lowerName)
+        return &kv.second;
     }
+    return nullptr;
+  }
+};
+
+enum class ParseStatus { Incomplete, Complete, Invalid, TooLarge };
+
+static constexpr size_t kMaxRequestHead = 8192;
+static constexpr size_t kMaxRequestBody = 1 << 20;
 
-    std::thread t(
-        [fd, rootDir, publicDir]() { handleClient(fd, rootDir, publicDir); });
-    t.detach();
+static std::string trimSpaces(const std::string &s) {
+  size_t b = 0;
+  size_t e = s.size();
+  while (b < e && (s[b] == ' ' || s[b] == '\t'))
+    b++;
+  while (e > b && (s[e - 1] == ' ' || s[e - 1] == '\t'))
+    e--;
+  return s.substr(b, e - b);
+}
+
+// 从 buf[offset] 开始解析一个完整请求（请求行 + 头 + 可选 content-length
+// 请求体）。scanFrom 记录上次查找头部结束符的位置，半包到达时不必从头再扫。
+static ParseStatus parseRequest(const std::string &buf, size_t offset,
+                                size_t &scanFrom, HttpRequest &out,
+                                size_t &consumed) {
+  const size_t from = std::max(offset, scanFrom > 3 ? scanFrom - 3 : 0);
+  const size_t headEnd = buf.find("\r\n\r\n", from);
+  if (headEnd == std::string::npos) {
+    scanFrom = buf.size();
+    if (buf.size() - offset > kMaxRequestHead)
+      return ParseStatus::TooLarge;
+    return ParseStatus::Incomplete;
   }
+  if (headEnd - offset > kMaxRequestHead)
+    return ParseStatus::TooLarge;
 
-  ::close(serverFd);
-  return 0;
+  out = HttpRequest();
+  size_t lineStart = offset;
+  size_t lineEnd = buf.find("\r\n", lineStart);
+  {
+    const std::string line = buf.substr(lineStart, lineEnd - lineStart);
+    const auto sp1 = line.find(' ');
+    const auto sp2 = sp1 == std::string::npos ? std::string::npos
+                                              : line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos)
+      return ParseStatus::Invalid;
+    out.method = line.substr(0, sp1);
+    out.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    out.version = line.substr(sp2 + 1);
+    if (out.method.empty() || out.target.empty() ||
+        !startsWith(out.version, "HTTP/1."))
+      return ParseStatus::Invalid;
+  }
+
+  while (lineEnd < headEnd) {
+    lineStart = lineEnd + 2;
+    lineEnd = buf.find("\r\n", lineStart);
+    const std::string line = buf.substr(lineStart, lineEnd - lineStart);
+    const auto colon = line.find(':');
+    if (colon == std::string::npos || colon == 0)
+      return ParseStatus::Invalid;
+    out.headers.emplace_back(toLower(line.substr(0, colon)),
+                             trimSpaces(line.substr(colon + 1)));
+  }
+
+  const std::string *conn = out.header("connection");
+  const std::string connValue = conn ? toLower(*conn) : std::string();
+  if (out.version == "HTTP/1.0") {
+    out.keepAlive = connValue.find("keep-alive") != std::string::npos;
+  } else {
+    out.keepAlive = connValue.find("close") == std::string::npos;
+  }
+
+  if (out.header("transfer-encoding"))
+    return ParseStatus::Invalid;
+
+  size_t bodyLen = 0;
+  if (const std::string *cl = out.header("content-length")) {
+    char *end = nullptr;
+    const unsigned long long v = std::strtoull(cl->c_str(), &end, 10);
+    if (!end || *end != '\0' || cl->empty())
+      return ParseStatus::Invalid;
+    if (v > kMaxRequestBody)
+      return ParseStatus::Invalid;
+    bodyLen = (size_t)v;
+  }
+  const size_t total = headEnd + 4 - offset + bodyLen;
+  if (buf.size() - offset < total)
+    return ParseStatus::Incomplete;
+
+  consumed = total;
+  scanFrom = offset + total;
+  return ParseStatus::Complete;
+}
+
+// 选定的一个表示（某个编码版本的文件）及其响应头
+struct Representation {
+  CachedFilePtr cached;
+  UniqueFd file;
+  off_t size = 0;
+  time_t mtime = 0;
+  std::string contentType;
+  std::string etag;
+  std::string headers;
+};
+
+static std::string validatorHeaders(const std::string &etag,
+                                    const std::string &lastModified,
+                                    const std::string &cacheControl) {
+  std::string out;
+  out.reserve(96 + cacheControl.size());
+  out.append("etag: ").append(etag).append("\r\n");
+  out.append("last-modified: ").append(lastModified).append("\r\n");
+  out.append("cache-control: ").append(cacheControl).append("\r\n");
+  out.append("accept-ranges: bytes\r\n");
+  return out;
+}
+
+// If-None-Match 优先（弱比较，忽略 W/ 前缀）；没有时才看 If-Modified-Since
+static bool notModified(const HttpRequest &req, const std::string &etag,
+                        time_t mtime) {
+  if (const std::string *inm = req.header("if-none-match")) {
+    size_t pos = 0;
+    while (pos < inm->size()) {
+      size_t comma = inm->find(',', pos);
+      if (comma == std::string::npos)
+        comma = inm->size();
+      std::string tag = trimSpaces(inm->substr(pos, comma - pos));
+      pos = comma + 1;
+      if (tag == "*")
+        return true;
+      if (startsWith(tag, "W/"))
+        tag = tag.substr(2);
+      if (tag == etag)
+        return true;
+    }
+    return false;
+  }
+  if (const std::string *ims = req.header("if-modified-since")) {
+    time_t since = 0;
+    if (parseHttpDate(*ims, since))
+      return mtime <= since;
+  }
+  return false;
+}
+
+static Response notModifiedResponse(const std::string &headers,
+                                    bool keepAlive) {
+  Response r;
+  r.head.append("HTTP/1.1 304 Not Modified\r\n");
+  r.head.append(headers);
+  r.head.append(keepAlive ? "connection: keep-alive\r\n\r\n"
+                          : "connection: close\r\n\r\n");
+  return r;
+}
+
+// 闭区间 [first, last]
+struct ByteRange {
+  off_t first;
+  off_t last;
+};
+
+enum class RangeResult { Ignore, Unsatisfiable, Ok };
+
+// 区间数上限，防止大量小区间放大请求
+static constexpr size_t kMaxRanges = 32;
+
+static bool parseOffset(const std::string &s, off_t &out) {
+  if (s.empty() || s.size() > 18)
+    return false;
+  off_t v = 0;
+  for (const char c : s) {
+    if (c < '0' || c > '9')
+      return false;
+    v = v * 10 + (c - '0');
+  }
+  out = v;
+  return true;
+}
+
+// 解析 "bytes=a-b, c-, -n"。语法错误时忽略 Range 返回整个文件；
+// 重叠或相邻的区间合并，避免同一段数据重复发送
+static RangeResult parseRange(const std::string &value, off_t size,
+                              std::vector<ByteRange> &out) {
+  const auto eq = value.find('=');
+  if (eq == std::string::npos || toLower(trimSpaces(value.substr(0, eq))) !=
+                                     "bytes")
+    return RangeResult::Ignore;
+  size_t specs = 0;
+  size_t pos = eq + 1;
+  while (pos <= value.size()) {
+    size_t comma = value.find(',', pos);
+    if (comma == std::string::npos)
+      comma = value.size();
+    const auto spec = trimSpaces(value.substr(pos, comma - pos));
+    pos = comma + 1;
+    if (spec.empty())
+      continue;
+    if (++specs > kMaxRanges)
+      return RangeResult::Ignore;
+    const auto dash = spec.find('-');
+    if (dash == std::string::npos)
+      return RangeResult::Ignore;
+    off_t first = 0;
+    off_t last = 0;
+    if (dash == 0) {
+      off_t suffix = 0;
+      if (!parseOffset(spec.substr(1), suffix))
+        return RangeResult::Ignore;
+      if (suffix == 0 || size == 0)
+        continue;
+      first = suffix >= size ? 0 : size - suffix;
+      last = size - 1;
+    } else {
+      if (!parseOffset(spec.substr(0, dash), first))
+        return RangeResult::Ignore;
+      if (dash + 1 == spec.size()) {
+        last = size - 1;
+      } else if (!parseOffset(spec.substr(dash + 1), last) || last < first) {
+        return RangeResult::Ignore;
+      }
+      if (first >= size)
+        continue;
+      last = std::min(last, size - 1);
+    }
+    out.push_back({first, last});
+  }
+  if (specs == 0)
+    return RangeResult::Ignore;
+  if (out.empty())
+    return RangeResult::Unsatisfiable;
+  std::sort(out.begin(), out.end(), [](const ByteRange &a, const ByteRange &b) {
+    return a.first < b.first;
+  });
+  size_t n = 0;
+  for (size_t i = 1; i < out.size(); i++) {
+    if (out[i].first <= out[n].last + 1)
+      out[n].last = std::max(out[n].last, out[i].last);
+    else
+      out[++n] = out[i];
+  }
+  out.resize(n + 1);
+  return RangeResult::Ok;
+}
+
+// If-Range 的 ETag 必须强匹配；日期形式必须与 Last-Modified 完全相同
+static bool ifRangeMatches(const HttpRequest &req, const std::string &etag,
+                           time_t mtime) {
+  const std::string *ir = req.header("if-range");
+  if (!ir)
+    return true;
+  const auto v = trimSpaces(*ir);
+  if (startsWith(v, "W/"))
+    return false;
+  if (startsWith(v, "\""))
+    return v == etag;
+  time_t t = 0;
+  return parseHttpDate(v, t) && t == mtime;
+}
+
+// 把表示中 [first, first + len) 挂到一段输出上：内存内容只记偏移，
+// 文件走 sendfile。文件所有权由调用方处理
+static void attachBody(Response &r, const Representation &rep, off_t first,
+                       off_t len) {
+  if (len <= 0)
+    return;
+  if (rep.cached && rep.cached->inMemory) {
+    r.cached = rep.cached;
+    r.cachedBody = true;
+    r.cachedOff = (size_t)first;
+    r.cachedLen = (size_t)len;
+    return;
+  }
+  if (rep.cached && rep.cached->fd) {
+    r.cached = rep.cached;
+    r.fileFd = rep.cached->fd.get();
+  } else {
+    r.fileFd = rep.file.get();
+  }
+  r.fileOffset = first;
+  r.fileEnd = first + len;
+}
+
+static std::string contentRange(const ByteRange &r, off_t size) {
+  return "bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) +
+         "/" + std::to_string(size);
+}
+
+// multipart/byteranges：每个区间一段（分隔头接在该段的 head 后面，数据走
+// sendfile 或缓存内容），最后一段是结束分隔符并持有打开的文件
+static Response multipartResponse(const HttpRequest &req, Representation &rep,
+                                  const std::vector<ByteRange> &ranges,
+                                  bool keepAlive) {
+  const auto rangeHeader = *req.header("range");
+  char boundary[32];
+  std::snprintf(
+      boundary, sizeof(boundary), "%016llx",
+      (unsigned long long)fnv1a64(
+          fnv1a64(kFnvOffset, rep.etag.data(), rep.etag.size()),
+          rangeHeader.data(), rangeHeader.size()));
+
+  std::vector<std::string> partHeads;
+  size_t total = 0;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    std::string h;
+    h.append(i == 0 ? "--" : "\r\n--").append(boundary);
+    h.append("\r\ncontent-type: ").append(rep.contentType);
+    h.append("\r\ncontent-range: ")
+        .append(contentRange(ranges[i], rep.size))
+        .append("\r\n\r\n");
+    total += h.size() + (size_t)(ranges[i].last - ranges[i].first + 1);
+    partHeads.push_back(std::move(h));
+  }
+  const std::string closing = std::string("\r\n--") + boundary + "--\r\n";
+  total += closing.size();
+
+  Response r;
+  r.head = buildHead(206, "Partial Content",
+                     std::string("multipart/byteranges; boundary=") + boundary,
+                     total, keepAlive, rep.headers);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    Response part;
+    Response &seg = i == 0 ? r : part;
+    seg.head.append(partHeads[i]);
+    attachBody(seg, rep, ranges[i].first, ranges[i].last - ranges[i].first + 1);
+    if (i > 0)
+      r.parts.push_back(std::move(part));
+  }
+  Response tail;
+  tail.body = closing;
+  tail.ownedFile = std::move(rep.file);
+  r.parts.push_back(std::move(tail));
+  return r;
+}
+
+static Response representationResponse(const HttpRequest &req,
+                                       Representation &rep, bool keepAlive) {
+  if (notModified(req, rep.etag, rep.mtime))
+    return notModifiedResponse(rep.headers, keepAlive);
+
+  const std::string *rangeHeader = req.header("range");
+  std::vector<ByteRange> ranges;
+  if (rangeHeader && req.method == "GET" &&
+      ifRangeMatches(req, rep.etag, rep.mtime)) {
+    const auto result = parseRange(*rangeHeader, rep.size, ranges);
+    if (result == RangeResult::Unsatisfiable) {
+      Response r;
+      r.head = buildHead(416, "Range Not Satisfiable",
+                         "text/plain; charset=utf-8", 0, keepAlive,
+                         rep.headers + "content-range: bytes */" +
+                             std::to_string(rep.size) + "\r\n");
+      return r;
+    }
+    if (result == RangeResult::Ok && ranges.size() > 1)
+      return multipartResponse(req, rep, ranges, keepAlive);
+    if (result == RangeResult::Ok) {
+      const auto &range = ranges.front();
+      const off_t len = range.last - range.first + 1;
+      Response r;
+      r.head = buildHead(206, "Partial Content", rep.contentType, (size_t)len,
+                         keepAlive,
+                         rep.headers + "content-range: " +
+                             contentRange(range, rep.size) + "\r\n");
+      attachBody(r, rep, range.first, len);
+      r.ownedFile = std::move(rep.file);
+      return r;
+    }
+  }
+
+  Response r;
+  r.head = buildHead(200, "OK", rep.contentType, (size_t)rep.size, keepAlive,
+                     rep.headers);
+  if (req.method == "HEAD")
+    return r;
+  attachBody(r, rep, 0, rep.size);
+  r.ownedFile = std::move(rep.file);
+  return r;
+}
+
+// 缓存条目的一个编码版本；只缓存了元数据的文件在这里才打开，
+// 打开失败（刚被删除）时返回 false
+static bool cachedRepresentation(const CachedFilePtr &f,
+                                 const std::string &contentType,
+                                 const std::string &headers,
+                                 Representation &rep) {
+  if (!f->inMemory && !f->fd) {
+    rep.file = UniqueFd(::open(f->path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!rep.file)
+      return false;
+  }
+  rep.cached = f;
+  rep.size = f->size;
+  rep.mtime = f->mtime.tv_sec;
+  rep.contentType = contentType;
+  rep.etag = f->etag;
+  rep.headers = headers;
+  return true;
+}
+
+// 按 Accept-Encoding 选择编码版本（br 优先），并生成 content-encoding /
+// vary 头；只要资源存在压缩版本就带上 vary，保证中间缓存按编码区分
+static bool selectFromEntry(const CacheEntry &e, const AcceptEncoding &accept,
+                            const std::string &cacheControl,
+                            Representation &rep) {
+  const std::string vary =
+      (e.br || e.gzip) ? "vary: accept-encoding\r\n" : std::string();
+  struct Variant {
+    bool accepted;
+    const CachedFilePtr &file;
+    const char *encodingHeader;
+  };
+  const Variant variants[] = {
+      {accept.br, e.br, "content-encoding: br\r\n"},
+      {accept.gzip, e.gzip, "content-encoding: gzip\r\n"},
+      {true, e.file, ""}};
+  for (const auto &v : variants) {
+    if (!v.accepted || !v.file)
+      continue;
+    const auto headers =
+        vary + v.encodingHeader +
+        validatorHeaders(v.file->etag, v.file->lastModified, cacheControl);
+    if (cachedRepresentation(v.file, e.file->contentType, headers, rep))
+      return true;
+  }
+  return false;
+}
+
+// 快照命中直接应答。未命中不代表文件不存在：快照不跟随符号链接目录，
+// inotify 也可能漏掉事件，所以仍要查一次文件系统再决定是否走 SPA 回退。
+// 路径里带 "/." 的请求（如 "/./a.css"）键不规范，同样交给文件系统处理。
+static bool handleFromCache(const HttpRequest &req, const std::string &clean,
+                            const CacheSnapshot &snap,
+                            const AcceptEncoding &accept, bool keepAlive,
+                            Response &out) {
+  if (clean.find("/./") != std::string::npos || endsWith(clean, "/."))
+    return false;
+  Representation rep;
+  const auto it = snap.byUrl.find(clean);
+  if (it != snap.byUrl.end() &&
+      selectFromEntry(it->second, accept, it->second.cacheControl, rep)) {
+    out = representationResponse(req, rep, keepAlive);
+    return true;
+  }
+  return false;
+}
+
+// SPA 回退页优先用快照里的版本（内容与压缩版本都已在内存中）
+static bool cachedFallback(const HttpRequest &req, const std::string &clean,
+                           const ServeContext &ctx, const CacheSnapshot &snap,
+                           const AcceptEncoding &accept, bool keepAlive,
+                           Response &out) {
+  Representation rep;
+  if (!snap.fallback.file ||
+      !selectFromEntry(snap.fallback, accept,
+                       ctx.cacheControl.lookup(
+                           clean, snap.fallback.file->contentType),
+                       rep))
+    return false;
+  out = representationResponse(req, rep, keepAlive);
+  return true;
+}
+
+static void diskRepresentation(UniqueFd file, const struct stat &st,
+                               const std::string &contentType,
+                               const std::string &headers,
+                               const std::string &cacheControl,
+                               Representation &rep) {
+  rep.file = std::move(file);
+  rep.size = st.st_size;
+  rep.mtime = st.st_mtim.tv_sec;
+  rep.contentType = contentType;
+  rep.etag = statEtag(st);
+  rep.headers =
+      headers +
+      validatorHeaders(rep.etag, httpDate(st.st_mtim.tv_sec), cacheControl);
+}
+
+// 未启用缓存时：客户端接受压缩且存在 .br/.gz 兄弟文件就发送它。
+// 文本类资源总是带 vary，因为这里不知道兄弟文件是否存在
+static void selectFromDisk(const std::filesystem::path &path,
+                           const std::string &contentType, UniqueFd file,
+                           const struct stat &st, const AcceptEncoding &accept,
+                           const std::string &cacheControl,
+                           Representation &rep) {
+  if (!isCompressible(contentType)) {
+    diskRepresentation(std::move(file), st, contentType, std::string(),
+                       cacheControl, rep);
+    return;
+  }
+  const std::string vary = "vary: accept-encoding\r\n";
+  struct Variant {
+    bool accepted;
+    const char *coding;
+    const char *ext;
+  };
+  const Variant variants[] = {{accept.br, "br", ".br"},
+                              {accept.gzip, "gzip", ".gz"}};
+  for (const auto &v : variants) {
+    if (!v.accepted)
+      continue;
+    auto sibling = path;
+    sibling += v.ext;
+    UniqueFd zfile;
+    struct stat zst {};
+    if (openRegularFile(sibling, zfile, zst) == OpenResult::Ok) {
+      diskRepresentation(std::move(zfile), zst, contentType,
+                         vary + "content-encoding: " + v.coding + "\r\n",
+                         cacheControl, rep);
+      return;
+    }
+  }
+  diskRepresentation(std::move(file), st, contentType, vary, cacheControl,
+                     rep);
+}
+
+static Response handleRequest(const HttpRequest &req, const ServeContext &ctx,
+                              const CacheSnapshot *snap, bool keepAlive) {
+  const auto &method = req.method;
+  if (method != "GET" && method != "HEAD") {
+    return buildResponse(405, "Method Not Allowed",
+                         "text/plain; charset=utf-8", "Method Not Allowed",
+                         keepAlive, false);
+  }
+  const bool headOnly = method == "HEAD";
+
+  const auto clean = sanitizePath(req.target);
+  const auto accept = parseAcceptEncoding(req.header("accept-encoding"));
+  if (snap) {
+    Response cached;
+    if (handleFromCache(req, clean, *snap, accept, keepAlive, cached))
+      return cached;
+  }
+
+  std::filesystem::path candidate;
+  if (startsWith(clean, "/public/")) {
+    candidate = ctx.publicDir / clean.substr(std::string("/public/").size());
+  } else {
+    candidate = ctx.rootDir / clean.substr(1);
+  }
+
+  UniqueFd file;
+  struct stat st {};
+  auto opened = openRegularFile(candidate, file, st);
+  if (opened == OpenResult::Directory) {
+    candidate = candidate / "index.html";
+    opened = openRegularFile(candidate, file, st);
+  }
+
+  Representation rep;
+  if (opened != OpenResult::Ok) {
+    if (clean == "/favicon.ico")
+      return buildResponse(404, "Not Found", "text/plain; charset=utf-8",
+                           "Not Found", keepAlive, headOnly);
+    Response fallback;
+    if (snap &&
+        cachedFallback(req, clean, ctx, *snap, accept, keepAlive, fallback))
+      return fallback;
+    const auto fallbackIndex = ctx.rootDir / "index.html";
+    if (openRegularFile(fallbackIndex, file, st) != OpenResult::Ok) {
+      return buildResponse(404, "Not Found", "text/plain; charset=utf-8",
+                           "Not Found", keepAlive, headOnly);
+    }
+    const std::string ct = "text/html; charset=utf-8";
+    selectFromDisk(fallbackIndex, ct, std::move(file), st, accept,
+                   ctx.cacheControl.lookup(clean, ct), rep);
+    return representationResponse(req, rep, keepAlive);
+  }
+
+  const auto ct = guessContentType(candidate.string());
+  selectFromDisk(candidate, ct, std::move(file), st, accept,
+                 ctx.cacheControl.lookup(clean, ct), rep);
+  return representationResponse(req, rep, keepAlive);
+}
+
+static constexpr size_t kReadChunk = 16384;
+static constexpr size_t kMaxPendingOutput = 1 << 20;
+static constexpr size_t kMaxPipelined = 32;
+static constexpr int kMaxIov = 64;
+static constexpr int kMaxEvents = 256;
+static constexpr int kTimerTickMs = 1000;
+
+using SteadyClock = std::chrono::steady_clock;
+
+struct Connection {
+  int fd = -1;
+  std::string in;
+  size_t inOff = 0;
+  size_t scanFrom = 0;
+  std::deque<Response> out;
+  size_t outBytes = 0;
+  int requests = 0;
+  bool closeAfterFlush = false;
+  bool wantWrite = false;
+  SteadyClock::time_point lastActive;
+  std::list<Connection *>::iterator idlePos;
+};
+
+static void enqueueResponse(Connection *conn, Response resp) {
+  auto parts = std::move(resp.parts);
+  conn->outBytes += resp.memSize();
+  conn->out.push_back(std::move(resp));
+  for (auto &p : parts) {
+    conn->outBytes += p.memSize();
+    conn->out.push_back(std::move(p));
+  }
+}
+
+// 解析缓冲区里所有完整的请求（流水线），依次把响应追加到输出队列。
+// 积压的内存数据超过 kMaxPendingOutput 或响应数超过 kMaxPipelined 时
+// 暂停，等写空后再继续。两种 I/O 引擎共用
+static void processRequests(Connection *conn, const ServeContext &ctx,
+                            const CacheSnapshot *snap, bool draining) {
+  while (!conn->closeAfterFlush && conn->outBytes < kMaxPendingOutput &&
+         conn->out.size() < kMaxPipelined) {
+    HttpRequest req;
+    size_t consumed = 0;
+    const auto st =
+        parseRequest(conn->in, conn->inOff, conn->scanFrom, req, consumed);
+    if (st == ParseStatus::Incomplete)
+      break;
+    if (st == ParseStatus::Invalid) {
+      enqueueResponse(conn, buildResponse(400, "Bad Request",
+                                          "text/plain; charset=utf-8",
+                                          "Bad Request", false, false));
+      conn->closeAfterFlush = true;
+      break;
+    }
+    if (st == ParseStatus::TooLarge) {
+      enqueueResponse(conn,
+                      buildResponse(431, "Request Header Fields Too Large",
+                                    "text/plain; charset=utf-8",
+                                    "Request Header Fields Too Large", false,
+                                    false));
+      conn->closeAfterFlush = true;
+      break;
+    }
+
+    conn->inOff += consumed;
+    conn->requests++;
+    const bool keepAlive = req.keepAlive && !draining &&
+                           conn->requests < ctx.maxRequestsPerConnection;
+    enqueueResponse(conn, handleRequest(req, ctx, snap, keepAlive));
+    if (!keepAlive)
+      conn->closeAfterFlush = true;
+  }
+
+  if (conn->inOff == conn->in.size()) {
+    conn->in.clear();
+    conn->inOff = 0;
+    conn->scanFrom = 0;
+  } else if (conn->inOff > kReadChunk) {
+    conn->in.erase(0, conn->inOff);
+    conn->scanFrom -= conn->inOff;
+    conn->inOff = 0;
+  }
+}
+
+// 把 n 字节已发送的内存数据记到队首若干响应上，发完的出队
+static void consumeOutput(Connection *conn, size_t n) {
+  while (n > 0 && !conn->out.empty()) {
+    auto &r = conn->out.front();
+    const size_t take = std::min(n, r.memSize() - r.memOff);
+    r.memOff += take;
+    conn->outBytes -= take;
+    n -= take;
+    if (!r.done())
+      break;
+    conn->out.pop_front();
+  }
+}
+
+// 收集队首起连续的内存数据（可跨多个流水线响应），遇到文件区间为止
+static int gatherOutput(Connection *conn, iovec *iov, int maxIov) {
+  int cnt = 0;
+  for (auto &r : conn->out) {
+    if (cnt + 2 > maxIov)
+      break;
+    size_t off = r.memOff;
+    if (off < r.head.size()) {
+      iov[cnt].iov_base = r.head.data() + off;
+      iov[cnt].iov_len = r.head.size() - off;
+      cnt++;
+      off = 0;
+    } else {
+      off -= r.head.size();
+    }
+    const auto body = r.bodyView();
+    if (off < body.size()) {
+      iov[cnt].iov_base = const_cast<char *>(body.data()) + off;
+      iov[cnt].iov_len = body.size() - off;
+      cnt++;
+    }
+    if (r.fileOffset < r.fileEnd)
+      break;
+  }
+  return cnt;
+}
+
+// SIGTERM/SIGINT 置位并写 eventfd，唤醒所有事件循环开始排空
+static std::atomic<bool> gDrainRequested{false};
+static int gDrainFd = -1;
+
+static void onDrainSignal(int) {
+  gDrainRequested.store(true);
+  if (gDrainFd >= 0) {
+    const uint64_t one = 1;
+    (void)!::write(gDrainFd, &one, sizeof(one));
+  }
+}
+
+// 进程内所有事件循环共享的监听 socket；最后一个停止 accept 的循环负责关闭，
+// 让内核尽快把新连接分给其他 SO_REUSEPORT 监听者
+struct Listener {
+  int fd = -1;
+  std::atomic<int> accepting{0};
+};
+
+// 一个工作线程的 I/O 循环；epoll 与 io_uring 两种实现
+class IoLoop {
+public:
+  virtual ~IoLoop() = default;
+  virtual bool init() = 0;
+  virtual void run() = 0;
+};
+
+// 每个工作线程持有一个 epoll 实例，共享同一个非阻塞监听 socket
+// （EPOLLEXCLUSIVE 避免惊群），连接只在接受它的线程里处理。
+// 连接按最近活跃时间串在 idle_ 链表里，超时检查只看链表头部。
+class EventLoop : public IoLoop {
+public:
+  EventLoop(Listener &listener, const ServeContext &ctx)
+      : listener_(listener), listenFd_(listener.fd), ctx_(ctx) {}
+
+  ~EventLoop() override {
+    for (auto &kv : conns_) {
+      ::close(kv.first);
+    }
+    if (epfd_ >= 0) {
+      ::close(epfd_);
+    }
+  }
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  bool init() override {
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+      std::perror("epoll_create1");
+      return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = nullptr;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, listenFd_, &ev) != 0) {
+      std::perror("epoll_ctl");
+      return false;
+    }
+    listener_.accepting++;
+    if (gDrainFd >= 0) {
+      epoll_event dev{};
+      dev.events = EPOLLIN;
+      dev.data.ptr = &gDrainFd;
+      ::epoll_ctl(epfd_, EPOLL_CTL_ADD, gDrainFd, &dev);
+    }
+    return true;
+  }
+
+  void run() override {
+    epoll_event events[kMaxEvents];
+    while (true) {
+      const int n = ::epoll_wait(epfd_, events, kMaxEvents, kTimerTickMs);
+      if (n < 0 && errno != EINTR) {
+        std::perror("epoll_wait");
+        return;
+      }
+      refreshSnapshot();
+      for (int i = 0; i < n; i++) {
+        if (events[i].data.ptr == &gDrainFd)
+          continue;
+        auto *conn = static_cast<Connection *>(events[i].data.ptr);
+        if (!conn) {
+          if (!draining_)
+            acceptAll();
+          continue;
+        }
+        const uint32_t e = events[i].events;
+        if (e & (EPOLLHUP | EPOLLERR)) {
+          closeConnection(conn);
+          continue;
+        }
+        if ((e & EPOLLIN) && !onReadable(conn))
+          continue;
+        if ((e & EPOLLOUT) && !flush(conn))
+          continue;
+      }
+      expireIdle();
+      if (!draining_ && gDrainRequested.load())
+        beginDrain();
+      if (draining_ && drainStep())
+        return;
+    }
+  }
+
+private:
+  Listener &listener_;
+  int listenFd_;
+  bool draining_{false};
+  SteadyClock::time_point drainDeadline_{};
+  int epfd_{-1};
+  const ServeContext &ctx_;
+  std::unordered_map<int, std::unique_ptr<Connection>> conns_;
+  std::list<Connection *> idle_;
+  std::shared_ptr<const CacheSnapshot> snap_;
+  uint64_t snapVersion_{0};
+
+  // 每轮事件循环只读一次版本号，变化时才去取新快照
+  void refreshSnapshot() {
+    if (!ctx_.cache)
+      return;
+    const uint64_t v = ctx_.cache->version();
+    if (v == snapVersion_ && snap_)
+      return;
+    snap_ = ctx_.cache->snapshot();
+    snapVersion_ = v;
+  }
+
+  void acceptAll() {
+    while (true) {
+      const int fd =
+          ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR)
+          continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+          std::perror("accept4");
+        return;
+      }
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      auto conn = std::make_unique<Connection>();
+      conn->fd = fd;
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.ptr = conn.get();
+      if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        ::close(fd);
+        continue;
+      }
+      conn->lastActive = SteadyClock::now();
+      conn->idlePos = idle_.insert(idle_.end(), conn.get());
+      conns_[fd] = std::move(conn);
+    }
+  }
+
+  // 排空：停止 accept，空闲连接立即关闭，进行中的请求应答后带
+  // connection: close 关闭
+  void beginDrain() {
+    draining_ = true;
+    drainDeadline_ =
+        SteadyClock::now() + std::chrono::seconds(ctx_.drainTimeoutSec);
+    if (gDrainFd >= 0)
+      ::epoll_ctl(epfd_, EPOLL_CTL_DEL, gDrainFd, nullptr);
+    ::epoll_ctl(epfd_, EPOLL_CTL_DEL, listenFd_, nullptr);
+    if (--listener_.accepting == 0) {
+      acceptAll();
+      ::close(listenFd_);
+    } else {
+      acceptAll();
+    }
+  }
+
+  // 返回 true 表示排空结束，可以退出循环
+  bool drainStep() {
+    std::vector<Connection *> idle;
+    for (auto &kv : conns_) {
+      auto *c = kv.second.get();
+      // 尚未发出请求的新连接可能还有数据在内核缓冲里，交给超时处理
+      if (c->requests > 0 && c->out.empty() && c->inOff == c->in.size())
+        idle.push_back(c);
+    }
+    for (auto *c : idle)
+      closeConnection(c);
+    if (SteadyClock::now() >= drainDeadline_) {
+      while (!idle_.empty())
+        closeConnection(idle_.front());
+    }
+    return conns_.empty();
+  }
+
+  void touch(Connection *conn) {
+    conn->lastActive = SteadyClock::now();
+    idle_.splice(idle_.end(), idle_, conn->idlePos);
+  }
+
+  void expireIdle() {
+    const auto deadline =
+        SteadyClock::now() - std::chrono::seconds(ctx_.keepAliveTimeoutSec);
+    while (!idle_.empty() && idle_.front()->lastActive < deadline) {
+      closeConnection(idle_.front());
+    }
+  }
+
+  void closeConnection(Connection *conn) {
+    const int fd = conn->fd;
+    ::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    idle_.erase(conn->idlePos);
+    conns_.erase(fd);
+  }
+
+  void setWantWrite(Connection *conn, bool want) {
+    if (conn->wantWrite == want)
+      return;
+    conn->wantWrite = want;
+    epoll_event ev{};
+    ev.events = want ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = conn;
+    ::epoll_ctl(epfd_, EPOLL_CTL_MOD, conn->fd, &ev);
+  }
+
+  // 返回 false 表示连接已关闭
+  bool onReadable(Connection *conn) {
+    char buf[kReadChunk];
+    bool eof = false;
+    while (true) {
+      const ssize_t n = ::read(conn->fd, buf, sizeof(buf));
+      if (n > 0) {
+        conn->in.append(buf, (size_t)n);
+        if (conn->in.size() - conn->inOff > kMaxRequestHead + kReadChunk)
+          break;
+        continue;
+      }
+      if (n == 0) {
+        eof = true;
+        break;
+      }
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      closeConnection(conn);
+      return false;
+    }
+    touch(conn);
+
+    processRequests(conn, ctx_, snap_.get(), draining_);
+    if (eof) {
+      // 对端半关闭：已解析的请求照常应答，之后关闭
+      conn->closeAfterFlush = true;
+    }
+    return flush(conn);
+  }
+
+  // 发送一段数据：head/body 用 sendmsg 聚合写（可跨多个流水线响应），
+  // 文件区间用 sendfile，不经过用户态拷贝。
+  // 返回值 >0 表示有进展，0 表示需要等待可写，<0 表示连接出错
+  int writeSome(Connection *conn) {
+    auto &front = conn->out.front();
+    if (front.memOff < front.memSize()) {
+      iovec iov[kMaxIov];
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = (size_t)gatherOutput(conn, iov, kMaxIov);
+      const ssize_t n = ::sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+      if (n > 0) {
+        consumeOutput(conn, (size_t)n);
+        return 1;
+      }
+      if (n == 0)
+        return -1;
+    } else {
+      const ssize_t n = ::sendfile(conn->fd, front.fileFd,
+                                   &front.fileOffset,
+                                   (size_t)(front.fileEnd - front.fileOffset));
+      if (n > 0) {
+        if (front.done())
+          conn->out.pop_front();
+        return 1;
+      }
+      if (n == 0)
+        return -1; // 文件在发送过程中被截断，无法满足 content-length
+    }
+    if (errno == EINTR)
+      return 1;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    return -1;
+  }
+
+  // 尽量写完待发送数据；返回 false 表示连接已关闭
+  bool flush(Connection *conn) {
+    while (true) {
+      while (!conn->out.empty()) {
+        const int st = writeSome(conn);
+        if (st > 0)
+          continue;
+        if (st == 0) {
+          touch(conn);
+          setWantWrite(conn, true);
+          return true;
+        }
+        closeConnection(conn);
+        return false;
+      }
+
+      if (conn->closeAfterFlush) {
+        closeConnection(conn);
+        return false;
+      }
+      // 背压解除后继续处理已缓冲的流水线请求
+      if (conn->inOff < conn->in.size()) {
+        processRequests(conn, ctx_, snap_.get(), draining_);
+        if (!conn->out.empty() || conn->closeAfterFlush)
+          continue;
+      }
+      setWantWrite(conn, false);
+      return true;
+    }
+  }
+};
+
+#ifdef MINI_NEXT_HAVE_IO_URING
+static int uringSetup(unsigned entries, io_uring_params *p) {
+  return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                      unsigned flags) {
+  return (int)::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+                        nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, const void *arg,
+                         unsigned nrArgs) {
+  return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+// 不依赖 liburing 的最小封装：映射 SQ/CQ 环与 SQE 数组，取 SQE、批量提交、
+// 遍历 CQE。只在创建它的线程里使用
+class Uring {
+public:
+  Uring() = default;
+  ~Uring() {
+    if (sqes_)
+      ::munmap(sqes_, sqesLen_);
+    if (cqPtr_)
+      ::munmap(cqPtr_, cqLen_);
+    if (sqPtr_)
+      ::munmap(sqPtr_, sqLen_);
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  Uring(const Uring &) = delete;
+  Uring &operator=(const Uring &) = delete;
+
+  // 内核不支持 io_uring、被 seccomp 禁止或缺少 NODROP 时返回 false
+  bool init(unsigned entries) {
+    io_uring_params p{};
+    fd_ = uringSetup(entries, &p);
+    if (fd_ < 0)
+      return false;
+    if (!(p.features & IORING_FEAT_NODROP))
+      return false;
+    sqLen_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqLen_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    sqesLen_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqPtr_ = map(sqLen_, IORING_OFF_SQ_RING);
+    cqPtr_ = map(cqLen_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe *>(map(sqesLen_, IORING_OFF_SQES));
+    if (!sqPtr_ || !cqPtr_ || !sqes_)
+      return false;
+    auto *sq = static_cast<char *>(sqPtr_);
+    auto *cq = static_cast<char *>(cqPtr_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sqEntries_ = p.sq_entries;
+    sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  bool supports(std::initializer_list<int> ops) const {
+    const size_t len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> buf(len, 0);
+    auto *probe = reinterpret_cast<io_uring_probe *>(buf.data());
+    if (uringRegister(fd_, IORING_REGISTER_PROBE, probe, 256) < 0)
+      return false;
+    for (const int op : ops) {
+      if (op > probe->last_op ||
+          !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    }
+    return true;
+  }
+
+  int fd() const { return fd_; }
+
+  // SQ 满时先把已填好的提交掉；返回的 SQE 已清零
+  io_uring_sqe *sqe() {
+    const unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_) {
+      submitAndWait(0);
+      if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+        return nullptr;
+    }
+    const unsigned idx = sqeTail_ & sqMask_;
+    io_uring_sqe *e = &sqes_[idx];
+    std::memset(e, 0, sizeof(*e));
+    sqArray_[idx] = idx;
+    sqeTail_++;
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    toSubmit_++;
+    return e;
+  }
+
+  // 一次系统调用完成提交与等待
+  int submitAndWait(unsigned waitNr) {
+    const int n = uringEnter(fd_, toSubmit_, waitNr,
+                             waitNr > 0 ? IORING_ENTER_GETEVENTS : 0);
+    if (n > 0)
+      toSubmit_ -= std::min(toSubmit_, (unsigned)n);
+    return n;
+  }
+
+  template <typename F> void forEachCqe(F &&f) {
+    unsigned head = *cqHead_;
+    while (true) {
+      const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+      if (head == tail)
+        break;
+      while (head != tail) {
+        const io_uring_cqe cqe = cqes_[head & cqMask_];
+        head++;
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        f(cqe);
+      }
+    }
+  }
+
+private:
+  int fd_ = -1;
+  void *sqPtr_ = nullptr;
+  void *cqPtr_ = nullptr;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqLen_ = 0;
+  size_t cqLen_ = 0;
+  size_t sqesLen_ = 0;
+  unsigned *sqHead_ = nullptr;
+  unsigned *sqTail_ = nullptr;
+  unsigned *sqArray_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned sqEntries_ = 0;
+  unsigned sqeTail_ = 0;
+  unsigned toSubmit_ = 0;
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+
+  void *map(size_t len, off_t offset) {
+    void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+};
+
+static constexpr unsigned kUringEntries = 1024;
+static constexpr unsigned kRecvBufCount = 256;
+static constexpr unsigned kFileSlotCount = 32;
+static constexpr size_t kFileSlotSize = 64 * 1024;
+
+// user_data 小于 kTagMax 的是全局操作，其余是连接指针
+enum : uint64_t {
+  kTagAccept = 1,
+  kTagTick,
+  kTagDrain,
+  kTagProvide,
+  kTagCancel,
+  kTagMax
+};
+
+enum class UringOp { None, Recv, SendMsg, ReadFile, SendChunk };
+
+struct UringConnection : Connection {
+  UringOp op = UringOp::None;
+  bool closing = false;
+  int slot = -1;
+  size_t chunkLen = 0;
+  size_t chunkOff = 0;
+  iovec iov[kMaxIov];
+  msghdr msg{};
+};
+
+// io_uring 事件循环：accept/recv/send/文件读取都以 SQE 提交，每轮只调用
+// 一次 io_uring_enter 完成提交与等待。recv 用内核选择的共享缓冲区
+// （PROVIDE_BUFFERS），空闲长连接不占缓冲；文件内容以 READ_FIXED 读入
+// 预先注册的缓冲槽再发送。每个连接同一时刻至多一个进行中的操作
+class UringLoop : public IoLoop {
+public:
+  UringLoop(Listener &listener, const ServeContext &ctx)
+      : listener_(listener), listenFd_(listener.fd), ctx_(ctx) {}
+
+  ~UringLoop() override {
+    for (auto &kv : conns_) {
+      ::close(kv.first);
+    }
+  }
+
+  bool init() override {
+    if (!ring_.init(kUringEntries))
+      return false;
+    if (!ring_.supports({IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                         IORING_OP_SENDMSG, IORING_OP_READ_FIXED,
+                         IORING_OP_READ, IORING_OP_PROVIDE_BUFFERS,
+                         IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL,
+                         IORING_OP_POLL_ADD}))
+      return false;
+
+    slotPool_.resize(kFileSlotCount * kFileSlotSize);
+    std::vector<iovec> iov(kFileSlotCount);
+    for (unsigned i = 0; i < kFileSlotCount; i++) {
+      iov[i].iov_base = slotPool_.data() + i * kFileSlotSize;
+      iov[i].iov_len = kFileSlotSize;
+      freeSlots_.push_back((int)i);
+    }
+    // 注册失败（如 RLIMIT_MEMLOCK 太小）时退回普通 READ
+    fixedSlots_ = uringRegister(ring_.fd(), IORING_REGISTER_BUFFERS,
+                                iov.data(), kFileSlotCount) == 0;
+
+    recvPool_.resize(kRecvBufCount * kReadChunk);
+    auto *sqe = ring_.sqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = (int)kRecvBufCount;
+    sqe->addr = (uint64_t)(uintptr_t)recvPool_.data();
+    sqe->len = (unsigned)kReadChunk;
+    sqe->off = 0;
+    sqe->buf_group = 0;
+    sqe->user_data = kTagProvide;
+    if (ring_.submitAndWait(1) < 0)
+      return false;
+    bool provided = false;
+    ring_.forEachCqe([&](const io_uring_cqe &cqe) {
+      if (cqe.user_data == kTagProvide)
+        provided = cqe.res >= 0;
+    });
+    if (!provided)
+      return false;
+
+    listener_.accepting++;
+    armAccept();
+    armTick();
+    armDrainWatch();
+    return true;
+  }
+
+  void run() override {
+    while (true) {
+      if (ring_.submitAndWait(1) < 0 && errno != EINTR && errno != EBUSY) {
+        std::perror("io_uring_enter");
+        return;
+      }
+      refreshSnapshot();
+      ring_.forEachCqe([this](const io_uring_cqe &cqe) { dispatch(cqe); });
+      retryRecv();
+      expireIdle();
+      if (!draining_ && gDrainRequested.load())
+        beginDrain();
+      if (draining_ && drainStep())
+        return;
+    }
+  }
+
+private:
+  Listener &listener_;
+  int listenFd_;
+  const ServeContext &ctx_;
+  Uring ring_;
+  std::unordered_map<int, std::unique_ptr<UringConnection>> conns_;
+  std::list<Connection *> idle_;
+  std::shared_ptr<const CacheSnapshot> snap_;
+  uint64_t snapVersion_{0};
+  std::vector<char> recvPool_;
+  std::vector<char> slotPool_;
+  std::vector<int> freeSlots_;
+  bool fixedSlots_{false};
+  std::deque<int> waitingSlot_;
+  std::vector<int> recvRetry_;
+  __kernel_timespec tick_{kTimerTickMs / 1000, 0};
+  bool acceptArmed_{false};
+  bool draining_{false};
+  bool listenerReleased_{false};
+  SteadyClock::time_point drainDeadline_{};
+
+  void refreshSnapshot() {
+    if (!ctx_.cache)
+      return;
+    const uint64_t v = ctx_.cache->version();
+    if (v == snapVersion_ && snap_)
+      return;
+    snap_ = ctx_.cache->snapshot();
+    snapVersion_ = v;
+  }
+
+  void armAccept() {
+    auto *sqe = ring_.sqe();
+    if (!sqe)
+      return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd_;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = kTagAccept;
+    acceptArmed_ = true;
+  }
+
+  void armTick() {
+    auto *sqe = ring_.sqe();
+    if (!sqe)
+      return;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)&tick_;
+    sqe->len = 1;
+    sqe->user_data = kTagTick;
+  }
+
+  void armDrainWatch() {
+    if (gDrainFd < 0)
+      return;
+    auto *sqe = ring_.sqe();
+    if (!sqe)
+      return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = gDrainFd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = kTagDrain;
+  }
+
+  void provideBuffer(unsigned bid) {
+    auto *sqe = ring_.sqe();
+    if (!sqe)
+      return;
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = (uint64_t)(uintptr_t)(recvPool_.data() + bid * kReadChunk);
+    sqe->len = (unsigned)kReadChunk;
+    sqe->off = bid;
+    sqe->buf_group = 0;
+    sqe->user_data = kTagProvide;
+  }
+
+  void dispatch(const io_uring_cqe &cqe) {
+    switch (cqe.user_data) {
+    case kTagAccept:
+      onAccept(cqe.res);
+      return;
+    case kTagTick:
+      armTick();
+      return;
+    case kTagDrain:
+      if (!gDrainRequested.load())
+        armDrainWatch();
+      return;
+    case kTagProvide:
+    case kTagCancel:
+      return;
+    default:
+      break;
+    }
+    auto *conn = reinterpret_cast<UringConnection *>(cqe.user_data);
+    const UringOp op = conn->op;
+    conn->op = UringOp::None;
+    switch (op) {
+    case UringOp::Recv:
+      onRecv(conn, cqe.res, cqe.flags);
+      break;
+    case UringOp::SendMsg:
+      onSendMsg(conn, cqe.res);
+      break;
+    case UringOp::ReadFile:
+      onReadFile(conn, cqe.res);
+      break;
+    case UringOp::SendChunk:
+      onSendChunk(conn, cqe.res);
+      break;
+    case UringOp::None:
+      break;
+    }
+  }
+
+  void onAccept(int res) {
+    acceptArmed_ = false;
+    if (res >= 0) {
+      int one = 1;
+      ::setsockopt(res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      auto conn = std::make_unique<UringConnection>();
+      conn->fd = res;
+      conn->lastActive = SteadyClock::now();
+      conn->idlePos = idle_.insert(idle_.end(), conn.get());
+      auto *c = conn.get();
+      conns_[res] = std::move(conn);
+      armRecv(c);
+    } else if (res != -ECANCELED && res != -EAGAIN && res != -EINTR &&
+               res != -ECONNABORTED) {
+      errno = -res;
+      std::perror("accept");
+    }
+    if (!draining_) {
+      armAccept();
+    } else {
+      releaseListener();
+    }
+  }
+
+  void releaseListener() {
+    if (listenerReleased_)
+      return;
+    listenerReleased_ = true;
+    if (--listener_.accepting == 0)
+      ::close(listenFd_);
+  }
+
+  void armRecv(UringConnection *c) {
+    auto *sqe = ring_.sqe();
+    if (!sqe) {
+      recvRetry_.push_back(c->fd);
+      return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->len = (unsigned)kReadChunk;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = (uint64_t)(uintptr_t)c;
+    c->op = UringOp::Recv;
+  }
+
+  // 共享缓冲区暂时用完（-ENOBUFS）的连接在本轮处理完后重新提交 recv
+  void retryRecv() {
+    if (recvRetry_.empty())
+      return;
+    std::vector<int> fds;
+    fds.swap(recvRetry_);
+    for (const int fd : fds) {
+      const auto it = conns_.find(fd);
+      if (it == conns_.end())
+        continue;
+      auto *c = it->second.get();
+      if (c->closing)
+        finalize(c);
+      else if (c->op == UringOp::None)
+        armRecv(c);
+    }
+  }
+
+  void onRecv(UringConnection *c, int res, uint32_t flags) {
+    if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+      const unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      if (!c->closing)
+        c->in.append(recvPool_.data() + bid * kReadChunk, (size_t)res);
+      provideBuffer(bid);
+    }
+    if (c->closing) {
+      finalize(c);
+      return;
+    }
+    if (res == -ENOBUFS) {
+      recvRetry_.push_back(c->fd);
+      return;
+    }
+    if (res < 0) {
+      closeConnection(c);
+      return;
+    }
+    touch(c);
+    if (res == 0) {
+      // 对端半关闭：已解析的请求照常应答，之后关闭
+      processRequests(c, ctx_, snap_.get(), draining_);
+      c->closeAfterFlush = true;
+    } else {
+      processRequests(c, ctx_, snap_.get(), draining_);
+      if (c->in.size() - c->inOff > kMaxRequestHead + kReadChunk)
+        c->closeAfterFlush = true;
+    }
+    continueOutput(c);
+  }
+
+  // 输出队列非空就继续发送；发完后处理缓冲里剩余的流水线请求或继续读
+  void continueOutput(UringConnection *c) {
+    while (c->out.empty()) {
+      releaseSlot(c);
+      if (c->closeAfterFlush) {
+        closeConnection(c);
+        return;
+      }
+      if (c->inOff < c->in.size()) {
+        processRequests(c, ctx_, snap_.get(), draining_);
+        if (!c->out.empty() || c->closeAfterFlush)
+          continue;
+      }
+      armRecv(c);
+      return;
+    }
+    startSend(c);
+  }
+
+  void startSend(UringConnection *c) {
+    auto &front = c->out.front();
+    if (front.memOff < front.memSize()) {
+      auto *sqe = ring_.sqe();
+      if (!sqe) {
+        closeConnection(c);
+        return;
+      }
+      c->msg = msghdr{};
+      c->msg.msg_iov = c->iov;
+      c->msg.msg_iovlen = (size_t)gatherOutput(c, c->iov, kMaxIov);
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->fd = c->fd;
+      sqe->addr = (uint64_t)(uintptr_t)&c->msg;
+      sqe->msg_flags = MSG_NOSIGNAL;
+      sqe->user_data = (uint64_t)(uintptr_t)c;
+      c->op = UringOp::SendMsg;
+      return;
+    }
+    if (c->slot < 0) {
+      if (freeSlots_.empty()) {
+        waitingSlot_.push_back(c->fd);
+        return;
+      }
+      c->slot = freeSlots_.back();
+      freeSlots_.pop_back();
+    }
+    auto *sqe = ring_.sqe();
+    if (!sqe) {
+      closeConnection(c);
+      return;
+    }
+    const size_t len =
+        std::min(kFileSlotSize, (size_t)(front.fileEnd - front.fileOffset));
+    sqe->opcode = fixedSlots_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = front.fileFd;
+    sqe->addr = (uint64_t)(uintptr_t)slotData(c->slot);
+    sqe->len = (unsigned)len;
+    sqe->off = (uint64_t)front.fileOffset;
+    if (fixedSlots_)
+      sqe->buf_index = (uint16_t)c->slot;
+    sqe->user_data = (uint64_t)(uintptr_t)c;
+    c->op = UringOp::ReadFile;
+  }
+
+  char *slotData(int slot) { return slotPool_.data() + slot * kFileSlotSize; }
+
+  void onSendMsg(UringConnection *c, int res) {
+    if (c->closing) {
+      finalize(c);
+      return;
+    }
+    if (res <= 0) {
+      closeConnection(c);
+      return;
+    }
+    consumeOutput(c, (size_t)res);
+    touch(c);
+    continueOutput(c);
+  }
+
+  void onReadFile(UringConnection *c, int res) {
+    if (c->closing) {
+      finalize(c);
+      return;
+    }
+    // 0 表示文件在发送过程中被截断，无法满足 content-length
+    if (res <= 0) {
+      closeConnection(c);
+      return;
+    }
+    c->chunkLen = (size_t)res;
+    c->chunkOff = 0;
+    sendChunk(c);
+  }
+
+  void sendChunk(UringConnection *c) {
+    auto *sqe = ring_.sqe();
+    if (!sqe) {
+      closeConnection(c);
+      return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slotData(c->slot) + c->chunkOff);
+    sqe->len = (unsigned)(c->chunkLen - c->chunkOff);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)c;
+    c->op = UringOp::SendChunk;
+  }
+
+  void onSendChunk(UringConnection *c, int res) {
+    if (c->closing) {
+      finalize(c);
+      return;
+    }
+    if (res <= 0) {
+      closeConnection(c);
+      return;
+    }
+    touch(c);
+    auto &front = c->out.front();
+    c->chunkOff += (size_t)res;
+    front.fileOffset += res;
+    if (c->chunkOff < c->chunkLen) {
+      sendChunk(c);
+      return;
+    }
+    if (front.done()) {
+      c->out.pop_front();
+      releaseSlot(c);
+    }
+    continueOutput(c);
+  }
+
+  // 归还缓冲槽，并交给等待中的连接
+  void releaseSlot(UringConnection *c) {
+    if (c->slot < 0)
+      return;
+    freeSlots_.push_back(c->slot);
+    c->slot = -1;
+    while (!waitingSlot_.empty() && !freeSlots_.empty()) {
+      const int fd = waitingSlot_.front();
+      waitingSlot_.pop_front();
+      const auto it = conns_.find(fd);
+      if (it == conns_.end() || it->second->closing ||
+          it->second->op != UringOp::None || it->second->out.empty())
+        continue;
+      startSend(it->second.get());
+    }
+  }
+
+  void touch(Connection *conn) {
+    conn->lastActive = SteadyClock::now();
+    idle_.splice(idle_.end(), idle_, conn->idlePos);
+  }
+
+  void expireIdle() {
+    const auto deadline =
+        SteadyClock::now() - std::chrono::seconds(ctx_.keepAliveTimeoutSec);
+    while (!idle_.empty() && idle_.front()->lastActive < deadline) {
+      closeConnection(static_cast<UringConnection *>(idle_.front()));
+    }
+  }
+
+  // 有操作在进行时先 shutdown，等它的完成事件回来再释放连接
+  void closeConnection(UringConnection *c) {
+    if (c->closing)
+      return;
+    c->closing = true;
+    idle_.erase(c->idlePos);
+    if (c->op != UringOp::None) {
+      ::shutdown(c->fd, SHUT_RDWR);
+      return;
+    }
+    finalize(c);
+  }
+
+  void finalize(UringConnection *c) {
+    releaseSlot(c);
+    const int fd = c->fd;
+    ::close(fd);
+    conns_.erase(fd);
+  }
+
+  void beginDrain() {
+    draining_ = true;
+    drainDeadline_ =
+        SteadyClock::now() + std::chrono::seconds(ctx_.drainTimeoutSec);
+    if (acceptArmed_) {
+      auto *sqe = ring_.sqe();
+      if (sqe) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = kTagAccept;
+        sqe->user_data = kTagCancel;
+      }
+    } else {
+      releaseListener();
+    }
+  }
+
+  bool drainStep() {
+    std::vector<UringConnection *> idle;
+    for (auto &kv : conns_) {
+      auto *c = kv.second.get();
+      if (!c->closing && c->requests > 0 && c->out.empty() &&
+          c->inOff == c->in.size())
+        idle.push_back(c);
+    }
+    for (auto *c : idle)
+      closeConnection(c);
+    if (SteadyClock::now() >= drainDeadline_) {
+      while (!idle_.empty())
+        closeConnection(static_cast<UringConnection *>(idle_.front()));
+    }
+    return conns_.empty() && !acceptArmed_;
+  }
+};
+#endif
+
+static int parsePort(const char *s) {
+  if (!s)
+    return 3000;
+  char *end = nullptr;
+  const long v = std::strtol(s, &end, 10);
+  if (!end || *end != '\0')
+    return 3000;
+  if (v <= 0 || v > 65535)
+    return 3000;
+  return (int)v;
+}
+
+static int defaultThreadCount() {
+  const unsigned n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : (int)n;
+}
+
+static int parseNonNegative(const char *s, int fallback) {
+  if (!s)
+    return fallback;
+  char *end = nullptr;
+  const long v = std::strtol(s, &end, 10);
+  if (!end || *end != '\0' || v < 0 || v > 1000000)
+    return fallback;
+  return (int)v;
+}
+
+static int parseThreads(const char *s) {
+  if (!s)
+    return defaultThreadCount();
+  char *end = nullptr;
+  const long v = std::strtol(s, &end, 10);
+  if (!end || *end != '\0' || v <= 0 || v > 1024)
+    return defaultThreadCount();
+  return (int)v;
+}
+
+struct ServerOptions {
+  int port = 3000;
+  int threads = 0;
+  int cacheMb = 64;
+  bool precompress = false;
+  int workers = 0;
+  bool pinCpus = false;
+  std::string ioEngine = "epoll";
+};
+
+// listen 为 false 时只 bind 不监听，主进程用它在 fork 之前探测端口是否可用
+static int openListener(int port, bool reusePort, bool listen = true) {
+  const int fd =
+      ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    std::perror("socket");
+    return -2;
+  }
+
+  // SO_REUSEPORT 只在多 worker 时设置：各 worker 各自监听同一端口，由内核
+  // 分发连接，滚动替换时新旧 worker 可以同时监听。单进程模式不设，误启动的
+  // 第二个实例 bind 失败，而不是悄悄分走一部分连接
+  int opt = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  if (reusePort)
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons((uint16_t)port);
+
+  if (::bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    std::perror("bind");
+    ::close(fd);
+    return -3;
+  }
+
+  if (listen && ::listen(fd, SOMAXCONN) != 0) {
+    std::perror("listen");
+    ::close(fd);
+    return -4;
+  }
+  return fd;
+}
+
+// 单个服务进程：先加载缓存再监听，新 worker 就绪之前不会接到连接。
+// workerIndex < 0 表示单进程模式；replacing > 0 时就绪后通知被替换的旧 worker 排空；
+// readyFd >= 0 时就绪后向它写入自己的 pid，告诉主进程启动成功
+static int runServer(ServeContext &ctx, const ServerOptions &opts,
+                     int workerIndex, pid_t replacing, int readyFd = -1) {
+  gDrainFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  struct sigaction sa {};
+  sa.sa_handler = onDrainSignal;
+  ::sigemptyset(&sa.sa_mask);
+  ::sigaction(SIGTERM, &sa, nullptr);
+  ::sigaction(SIGINT, &sa, nullptr);
+  // worker 的 SIGHUP 保持忽略，由主进程负责滚动替换
+  if (workerIndex < 0)
+    ::sigaction(SIGHUP, &sa, nullptr);
+
+  std::unique_ptr<StaticCache> cache;
+  if (opts.cacheMb > 0) {
+    cache = std::make_unique<StaticCache>(
+        ctx.rootDir, (size_t)opts.cacheMb * 1024 * 1024, opts.precompress,
+        ctx.cacheControl);
+    if (cache->start()) {
+      ctx.cache = cache.get();
+    } else {
+      std::fprintf(stderr, "static cache disabled\n");
+      cache.reset();
+    }
+  }
+
+  Listener listener;
+  listener.fd = openListener(opts.port, workerIndex >= 0);
+  if (listener.fd < 0)
+    return -listener.fd;
+
+  // io_uring 不可用（内核太旧、被 seccomp 禁止等）时退回 epoll
+  bool useUring = opts.ioEngine == "io_uring";
+  std::vector<std::unique_ptr<IoLoop>> loops;
+  for (int i = 0; i < opts.threads; i++) {
+    std::unique_ptr<IoLoop> loop;
+#ifdef MINI_NEXT_HAVE_IO_URING
+    if (useUring) {
+      loop = std::make_unique<UringLoop>(listener, ctx);
+      if (!loop->init()) {
+        std::fprintf(stderr, "io_uring unavailable, falling back to epoll\n");
+        loop.reset();
+        useUring = false;
+      }
+    }
+#else
+    useUring = false;
+#endif
+    if (!loop) {
+      loop = std::make_unique<EventLoop>(listener, ctx);
+      if (!loop->init()) {
+        ::close(listener.fd);
+        return 5;
+      }
+    }
+    loops.push_back(std::move(loop));
+  }
+
+  if (workerIndex < 0) {
+    std::fprintf(stdout,
+                 "mini-next-serve listening on http://localhost:%d\n",
+                 opts.port);
+    std::fprintf(stdout, "dir: %s\n", ctx.rootDir.string().c_str());
+    std::fprintf(stdout, "threads: %d\n", opts.threads);
+    std::fprintf(stdout, "io engine: %s\n", useUring ? "io_uring" : "epoll");
+    if (ctx.cache) {
+      std::fprintf(stdout, "cache: %zu files, %zu bytes loaded\n",
+                   ctx.cache->fileCount(), ctx.cache->bytes());
+    }
+  } else {
+    std::fprintf(stdout, "worker %d (pid %d) ready\n", workerIndex,
+                 (int)::getpid());
+  }
+  std::fflush(stdout);
+  if (readyFd >= 0) {
+    const pid_t self = ::getpid();
+    (void)!::write(readyFd, &self, sizeof(self));
+    ::close(readyFd);
+  }
+  if (replacing > 0)
+    ::kill(replacing, SIGTERM);
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < loops.size(); i++) {
+    workers.emplace_back([&loops, i]() { loops[i]->run(); });
+  }
+  loops[0]->run();
+  for (auto &t : workers) {
+    t.join();
+  }
+  return 0;
+}
+
+// 第 index 个允许运行的 CPU；按 worker 序号轮流绑定
+static void pinToCpu(int index) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return;
+  const int count = CPU_COUNT(&allowed);
+  if (count <= 0)
+    return;
+  int nth = index % count;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed))
+      continue;
+    if (nth-- == 0) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      ::sched_setaffinity(0, sizeof(one), &one);
+      return;
+    }
+  }
+}
+
+struct WorkerSlot {
+  pid_t pid = 0;
+  SteadyClock::time_point started{};
+  SteadyClock::time_point restartAt{};
+  pid_t replacing = 0; // 下一个启动的 worker 就绪后要通知排空的旧 worker
+  bool ready = false;
+};
+
+// 被 SIGHUP 替换、等待新 worker 就绪后排空的旧 worker
+struct RetiringWorker {
+  pid_t pid = 0;
+  size_t slot = 0;
+  SteadyClock::time_point since{};
+  bool signalled = false;
+};
+
+// 新 worker 迟迟没有就绪（比如反复启动失败）时，主进程自己通知旧 worker 排空
+static constexpr auto kRetireTimeout = std::chrono::seconds(60);
+
+// 连续这么多个 worker 没有就绪就退出（端口被占、目录不可读等）时主进程放弃
+static constexpr int kMaxFailedStarts = 5;
+
+static pid_t spawnWorker(ServeContext &ctx, const ServerOptions &opts,
+                         int index, pid_t replacing, const int readyPipe[2]) {
+  std::fflush(stdout);
+  std::fflush(stderr);
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    std::perror("fork");
+    return -1;
+  }
+  if (pid > 0)
+    return pid;
+
+  sigset_t none;
+  ::sigemptyset(&none);
+  ::sigprocmask(SIG_SETMASK, &none, nullptr);
+  ::signal(SIGHUP, SIG_IGN);
+  ::close(readyPipe[0]);
+  if (opts.pinCpus)
+    pinToCpu(index);
+  const int code = runServer(ctx, opts, index, replacing, readyPipe[1]);
+  std::fflush(stdout);
+  std::_Exit(code);
+}
+
+// 主进程只做监督：worker 异常退出时重启（刚启动就退出的延迟 1 秒，避免
+// 反复 fork）；SIGHUP 逐个滚动替换 worker（新 worker 就绪后由它通知旧
+// worker 排空；新 worker 没就绪就退出时，重启的 worker 接着负责通知，
+// 超过 kRetireTimeout 由主进程直接通知）；SIGTERM/SIGINT 转发给所有 worker
+// 并等待它们排空退出。fork 之前先探测端口，连续 kMaxFailedStarts 个 worker
+// 没有就绪就退出时停止全部 worker 并返回非零
+static int superviseWorkers(ServeContext &ctx, const ServerOptions &opts) {
+  const int probe = openListener(opts.port, true, false);
+  if (probe < 0)
+    return -probe;
+  ::close(probe);
+  int readyPipe[2];
+  if (::pipe2(readyPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+    std::perror("pipe2");
+    return 1;
+  }
+
+  sigset_t set;
+  ::sigemptyset(&set);
+  ::sigaddset(&set, SIGTERM);
+  ::sigaddset(&set, SIGINT);
+  ::sigaddset(&set, SIGHUP);
+  ::sigaddset(&set, SIGCHLD);
+  ::sigprocmask(SIG_BLOCK, &set, nullptr);
+
+  std::fprintf(stdout, "mini-next-serve listening on http://localhost:%d\n",
+               opts.port);
+  std::fprintf(stdout, "dir: %s\n", ctx.rootDir.string().c_str());
+  std::fprintf(stdout, "workers: %d, threads per worker: %d\n", opts.workers,
+               opts.threads);
+
+  std::vector<WorkerSlot> slots((size_t)opts.workers);
+  std::vector<RetiringWorker> retiring;
+  bool stopping = false;
+  int failedStarts = 0;
+  int exitCode = 0;
+
+  while (true) {
+    const auto now = SteadyClock::now();
+    if (!stopping) {
+      for (size_t i = 0; i < slots.size(); i++) {
+        auto &slot = slots[i];
+        if (slot.pid > 0 || now < slot.restartAt)
+          continue;
+        const pid_t pid =
+            spawnWorker(ctx, opts, (int)i, slot.replacing, readyPipe);
+        if (pid > 0) {
+          slot.pid = pid;
+          slot.started = now;
+          slot.ready = false;
+          slot.replacing = 0;
+        } else {
+          slot.restartAt = now + std::chrono::seconds(1);
+        }
+      }
+    }
+
+    timespec tick{1, 0};
+    const int sig = ::sigtimedwait(&set, nullptr, &tick);
+    if ((sig == SIGTERM || sig == SIGINT) && !stopping) {
+      stopping = true;
+      std::fprintf(stdout, "draining workers\n");
+      std::fflush(stdout);
+      for (const auto &slot : slots) {
+        if (slot.pid > 0)
+          ::kill(slot.pid, SIGTERM);
+      }
+      for (const auto &r : retiring)
+        ::kill(r.pid, SIGTERM);
+    } else if (sig == SIGHUP && !stopping) {
+      std::fprintf(stdout, "restarting workers\n");
+      std::fflush(stdout);
+      for (size_t i = 0; i < slots.size(); i++) {
+        auto &slot = slots[i];
+        if (slot.pid <= 0)
+          continue;
+        const pid_t pid = spawnWorker(ctx, opts, (int)i, slot.pid, readyPipe);
+        if (pid <= 0)
+          continue;
+        retiring.push_back(RetiringWorker{slot.pid, i, SteadyClock::now()});
+        slot.pid = pid;
+        slot.started = SteadyClock::now();
+        slot.ready = false;
+      }
+    }
+
+    // 先收就绪通知再回收退出的 worker，就绪后才退出的不算启动失败
+    pid_t readyPid;
+    while (::read(readyPipe[0], &readyPid, sizeof(readyPid)) ==
+           (ssize_t)sizeof(readyPid)) {
+      for (auto &slot : slots) {
+        if (slot.pid == readyPid) {
+          slot.ready = true;
+          failedStarts = 0;
+        }
+      }
+    }
+
+    int status = 0;
+    pid_t pid;
+    while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+      const auto r = std::find_if(
+          retiring.begin(), retiring.end(),
+          [pid](const RetiringWorker &w) { return w.pid == pid; });
+      if (r != retiring.end()) {
+        if (slots[r->slot].replacing == pid)
+          slots[r->slot].replacing = 0;
+        retiring.erase(r);
+        continue;
+      }
+      for (size_t i = 0; i < slots.size(); i++) {
+        auto &slot = slots[i];
+        if (slot.pid != pid)
+          continue;
+        slot.pid = 0;
+        if (stopping)
+          break;
+        std::fprintf(stderr, "worker %zu (pid %d) exited with status %d\n", i,
+                     (int)pid, status);
+        if (!slot.ready && ++failedStarts >= kMaxFailedStarts) {
+          std::fprintf(stderr, "%d workers exited before becoming ready, "
+                               "giving up\n",
+                       failedStarts);
+          stopping = true;
+          exitCode = 1;
+          for (const auto &other : slots) {
+            if (other.pid > 0)
+              ::kill(other.pid, SIGTERM);
+          }
+          for (const auto &r : retiring)
+            ::kill(r.pid, SIGTERM);
+          break;
+        }
+        const auto exitedAt = SteadyClock::now();
+        slot.restartAt = exitedAt - slot.started < std::chrono::seconds(1)
+                             ? exitedAt + std::chrono::seconds(1)
+                             : exitedAt;
+        // 它可能还没来得及通知旧 worker 排空：交给重启的 worker 通知
+        for (auto w = retiring.rbegin(); w != retiring.rend(); ++w) {
+          if (w->slot == i && !w->signalled) {
+            slot.replacing = w->pid;
+            w->since = exitedAt;
+            break;
+          }
+        }
+        break;
+      }
+    }
+
+    const auto checkedAt = SteadyClock::now();
+    for (auto &w : retiring) {
+      if (!w.signalled && checkedAt - w.since >= kRetireTimeout) {
+        ::kill(w.pid, SIGTERM);
+        w.signalled = true;
+      }
+    }
+
+    if (stopping && retiring.empty() &&
+        std::all_of(slots.begin(), slots.end(),
+                    [](const WorkerSlot &w) { return w.pid <= 0; }))
+      return exitCode;
+  }
+}
+
+int main(int argc, char **argv) {
+  std::filesystem::path dir = std::filesystem::current_path();
+  ServerOptions opts;
+  ServeContext ctx;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string a = argv[i] ? std::string(argv[i]) : std::string();
+    if (a == "--dir" && i + 1 < argc) {
+      dir = std::filesystem::path(argv[++i]);
+      continue;
+    }
+    if (a == "--port" && i + 1 < argc) {
+      opts.port = parsePort(argv[++i]);
+      continue;
+    }
+    if (a == "--threads" && i + 1 < argc) {
+      opts.threads = parseThreads(argv[++i]);
+      continue;
+    }
+    if (a == "--workers" && i + 1 < argc) {
+      opts.workers = parseNonNegative(argv[++i], opts.workers);
+      continue;
+    }
+    if (a == "--io-engine" && i + 1 < argc) {
+      opts.ioEngine = argv[++i];
+      if (opts.ioEngine != "epoll" && opts.ioEngine != "io_uring") {
+        std::fprintf(stderr, "unknown --io-engine: %s\n",
+                     opts.ioEngine.c_str());
+        return 1;
+      }
+      continue;
+    }
+    if (a == "--pin-cpus") {
+      opts.pinCpus = true;
+      continue;
+    }
+    if (a == "--drain-timeout" && i + 1 < argc) {
+      ctx.drainTimeoutSec = parseNonNegative(argv[++i], ctx.drainTimeoutSec);
+      continue;
+    }
+    if (a == "--keep-alive-timeout" && i + 1 < argc) {
+      ctx.keepAliveTimeoutSec =
+          parseNonNegative(argv[++i], ctx.keepAliveTimeoutSec);
+      continue;
+    }
+    if (a == "--cache-control" && i + 1 < argc) {
+      const std::string rule = argv[++i];
+      const auto eq = rule.find('=');
+      if (eq == std::string::npos || eq == 0) {
+        std::fprintf(stderr, "invalid --cache-control rule: %s\n",
+                     rule.c_str());
+        return 1;
+      }
+      ctx.cacheControl.rules.push_back(
+          {rule.substr(0, eq), trimSpaces(rule.substr(eq + 1))});
+      continue;
+    }
+    if (a == "--precompress") {
+      opts.precompress = true;
+      continue;
+    }
+    if (a == "--cache-size" && i + 1 < argc) {
+      opts.cacheMb = parseNonNegative(argv[++i], opts.cacheMb);
+      continue;
+    }
+    if (a == "--max-requests" && i + 1 < argc) {
+      ctx.maxRequestsPerConnection =
+          parseNonNegative(argv[++i], ctx.maxRequestsPerConnection);
+      continue;
+    }
+    if (a == "-h" || a == "--help") {
+      std::fprintf(stdout,
+                   "Usage: mini-next-serve --dir <staticDir> --port <port> "
+                   "[--threads <n>] [--workers <n>] [--pin-cpus] "
+                   "[--io-engine epoll|io_uring] "
+                   "[--drain-timeout <sec>] [--keep-alive-timeout <sec>] "
+                   "[--max-requests <n>] [--cache-size <MB>] "
+                   "[--precompress] [--cache-control <glob>=<value>]\n");
+      std::fflush(stdout);
+      return 0;
+    }
+  }
+
+  ctx.rootDir = std::filesystem::absolute(dir);
+  ctx.publicDir = ctx.rootDir / "public";
+
+  if (opts.threads <= 0)
+    opts.threads = opts.workers > 0 ? 1 : defaultThreadCount();
+  if (opts.workers > 0)
+    return superviseWorkers(ctx, opts);
+  return runServer(ctx, opts, -1, 0);
 }
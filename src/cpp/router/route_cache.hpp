@@ -0,0 +1,214 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// 参数在 URL 中的字节区间 [begin, end)；matched=false 表示可选参数缺省
+struct ParamSpan {
+  uint32_t begin = 0;
+  uint32_t end = 0;
+  bool matched = false;
+};
+
+// 路由匹配结果缓存：只存 Route 指针和参数在 URL 中的偏移，不复制 Route。
+// 固定容量、按 hash 分片、4 路组相联；读路径是 seqlock，不加锁也不分配内存，
+// 写路径对分片 try_lock，拿不到锁就放弃这次写入，不阻塞请求。
+// 超过 kMaxKeyBytes 的 URL 或参数多于 kMaxParams 的路由直接走前缀树。
+class RouteResultCache {
+public:
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kWays = 4;
+  static constexpr size_t kMaxKeyBytes = 128;
+  static constexpr size_t kMaxParams = 8;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t capacity = 0;
+  };
+
+  explicit RouteResultCache(size_t capacity) {
+    size_t sets = (capacity + kShards * kWays - 1) / (kShards * kWays);
+    if (sets == 0) {
+      sets = 1;
+    }
+    setsPerShard_ = sets;
+    for (auto &shard : shards_) {
+      shard.entries = std::make_unique<Entry[]>(sets * kWays);
+    }
+  }
+
+  // generation 用来让旧路由表写入的条目自然失效，rescan 时无需清空；
+  // 指针只在持有同一 generation 的路由表期间有效
+  bool lookup(std::string_view url, uint32_t generation, const void *&route,
+              std::vector<ParamSpan> &spans) {
+    if (url.size() > kMaxKeyBytes) {
+      return false;
+    }
+    const uint64_t h = hashKey(url);
+    Shard &shard = shards_[h % kShards];
+    Entry *set = &shard.entries[((h / kShards) % setsPerShard_) * kWays];
+    for (size_t w = 0; w < kWays; w++) {
+      if (readEntry(set[w], url, h, generation, route, spans)) {
+        shard.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  void insert(std::string_view url, uint32_t generation, const void *route,
+              const std::vector<ParamSpan> &spans) {
+    if (url.size() > kMaxKeyBytes || spans.size() > kMaxParams) {
+      return;
+    }
+    const uint64_t h = hashKey(url);
+    Shard &shard = shards_[h % kShards];
+    std::unique_lock<std::mutex> lock(shard.writeMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return;
+    }
+    Entry *set = &shard.entries[((h / kShards) % setsPerShard_) * kWays];
+    Entry *victim = nullptr;
+    for (size_t w = 0; w < kWays && !victim; w++) {
+      const uint64_t tag = set[w].words[kTagWord].load(std::memory_order_relaxed);
+      if (static_cast<uint32_t>(tag) != generation + 1) {
+        victim = &set[w];
+      }
+    }
+    if (!victim) {
+      victim = &set[shard.clock++ % kWays];
+    }
+    writeEntry(*victim, url, h, generation, route, spans);
+  }
+
+  Stats stats() const {
+    Stats s;
+    for (const auto &shard : shards_) {
+      s.hits += shard.hits.load(std::memory_order_relaxed);
+      s.misses += shard.misses.load(std::memory_order_relaxed);
+    }
+    s.capacity = setsPerShard_ * kWays * kShards;
+    return s;
+  }
+
+private:
+  // 条目全部由原子字组成，seqlock 读到写了一半的条目只会判为未命中，不是数据竞争
+  static constexpr size_t kHashWord = 0;
+  static constexpr size_t kTagWord = 1;   // generation+1 | urlLen<<32 | paramCount<<48
+  static constexpr size_t kRouteWord = 2; // Route 指针，nullptr 表示确定不匹配
+  static constexpr size_t kSpanWord = 3;  // 每个字放两个 span
+  static constexpr size_t kKeyWord = kSpanWord + kMaxParams / 2;
+  static constexpr size_t kWords = kKeyWord + kMaxKeyBytes / 8;
+
+  struct alignas(64) Entry {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> words[kWords] = {};
+  };
+
+  struct alignas(64) Shard {
+    std::unique_ptr<Entry[]> entries;
+    std::mutex writeMutex;
+    uint32_t clock = 0;
+    alignas(64) std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
+
+  static uint64_t hashKey(std::string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  static uint32_t packSpan(const ParamSpan &s) {
+    return (s.begin & 0x7fff) | ((s.end & 0x7fff) << 15) |
+           (s.matched ? 1u << 30 : 0u);
+  }
+
+  static ParamSpan unpackSpan(uint32_t v) {
+    ParamSpan s;
+    s.begin = v & 0x7fff;
+    s.end = (v >> 15) & 0x7fff;
+    s.matched = (v >> 30) & 1;
+    return s;
+  }
+
+  static bool readEntry(const Entry &e, std::string_view url, uint64_t h,
+                        uint32_t generation, const void *&route,
+                        std::vector<ParamSpan> &spans) {
+    const uint64_t s1 = e.seq.load(std::memory_order_acquire);
+    if (s1 & 1) {
+      return false;
+    }
+    const uint64_t tag = e.words[kTagWord].load(std::memory_order_relaxed);
+    if (e.words[kHashWord].load(std::memory_order_relaxed) != h ||
+        static_cast<uint32_t>(tag) != generation + 1 ||
+        ((tag >> 32) & 0xffff) != url.size()) {
+      return false;
+    }
+    uint64_t key[kMaxKeyBytes / 8];
+    const size_t keyWords = (url.size() + 7) / 8;
+    for (size_t i = 0; i < keyWords; i++) {
+      key[i] = e.words[kKeyWord + i].load(std::memory_order_relaxed);
+    }
+    const size_t paramCount = (tag >> 48) & 0xff;
+    uint64_t packed[kMaxParams / 2];
+    for (size_t i = 0; i < (paramCount + 1) / 2; i++) {
+      packed[i] = e.words[kSpanWord + i].load(std::memory_order_relaxed);
+    }
+    const uint64_t routeWord = e.words[kRouteWord].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (e.seq.load(std::memory_order_relaxed) != s1) {
+      return false;
+    }
+    if (std::memcmp(key, url.data(), url.size()) != 0) {
+      return false;
+    }
+    route = reinterpret_cast<const void *>(static_cast<uintptr_t>(routeWord));
+    spans.resize(paramCount);
+    for (size_t i = 0; i < paramCount; i++) {
+      spans[i] = unpackSpan(static_cast<uint32_t>(packed[i / 2] >> (32 * (i % 2))));
+    }
+    return true;
+  }
+
+  static void writeEntry(Entry &e, std::string_view url, uint64_t h,
+                         uint32_t generation, const void *route,
+                         const std::vector<ParamSpan> &spans) {
+    uint64_t key[kMaxKeyBytes / 8] = {};
+    std::memcpy(key, url.data(), url.size());
+    uint64_t packed[kMaxParams / 2] = {};
+    for (size_t i = 0; i < spans.size(); i++) {
+      packed[i / 2] |= static_cast<uint64_t>(packSpan(spans[i])) << (32 * (i % 2));
+    }
+
+    const uint64_t s = e.seq.load(std::memory_order_relaxed);
+    e.seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.words[kHashWord].store(h, std::memory_order_relaxed);
+    e.words[kTagWord].store(static_cast<uint64_t>(generation + 1) |
+                                (static_cast<uint64_t>(url.size()) << 32) |
+                                (static_cast<uint64_t>(spans.size()) << 48),
+                            std::memory_order_relaxed);
+    e.words[kRouteWord].store(reinterpret_cast<uintptr_t>(route),
+                              std::memory_order_relaxed);
+    for (size_t i = 0; i < kMaxParams / 2; i++) {
+      e.words[kSpanWord + i].store(packed[i], std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < (url.size() + 7) / 8; i++) {
+      e.words[kKeyWord + i].store(key[i], std::memory_order_relaxed);
+    }
+    e.seq.store(s + 2, std::memory_order_release);
+  }
+
+  size_t setsPerShard_ = 1;
+  Shard shards_[kShards];
+};
@@ -0,0 +1,318 @@
+#include "route_matcher.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 二进制路由清单（本机字节序，记录都是 4 字节字段，可以直接 mmap 后读取）：
+//   ManifestHeader | ManifestRoute[routeCount] | ManifestSegment[segmentCount]
+//   | 字符串区[stringBytes]
+// 路由按匹配优先级顺序存放，参数名即非静态段的 text；pagesDir 下的文件
+// 存相对路径，构建目录和部署目录不同也能用。
+// pagesHash 是 pagesDir 下全部页面源文件相对路径排序后的 FNV-1a：路由表只由
+// 文件列表决定，不必读文件内容，对不上就退回全量扫描。
+
+namespace {
+
+constexpr char kManifestMagic[8] = {'M', 'N', 'R', 'O', 'U', 'T', 'E', 'S'};
+constexpr uint32_t kManifestVersion = 1;
+constexpr uint32_t kRouteRelativeFile = 1;
+
+struct ManifestHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t routeCount;
+  uint64_t pagesHash;
+  uint32_t segmentCount;
+  uint32_t stringBytes;
+};
+
+struct ManifestRoute {
+  uint32_t flags;
+  uint32_t pathOff;
+  uint32_t pathLen;
+  uint32_t fileOff;
+  uint32_t fileLen;
+  uint32_t firstSegment;
+  uint32_t segmentCount;
+};
+
+struct ManifestSegment {
+  uint32_t kind;
+  uint32_t textOff;
+  uint32_t textLen;
+};
+
+static_assert(sizeof(ManifestHeader) == 32, "manifest header layout");
+static_assert(sizeof(ManifestRoute) == 28, "manifest route layout");
+static_assert(sizeof(ManifestSegment) == 12, "manifest segment layout");
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_) {
+      munmap(const_cast<unsigned char *>(data_), size_);
+    }
+#endif
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path) {
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+    data_ = reinterpret_cast<const unsigned char *>(buffer_.data());
+    size_ = buffer_.size();
+    return true;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                   MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    data_ = static_cast<const unsigned char *>(p);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+#endif
+  }
+
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  std::string buffer_;
+#endif
+};
+
+template <typename T> T readRecord(const unsigned char *base, size_t offset) {
+  T out;
+  std::memcpy(&out, base + offset, sizeof(T));
+  return out;
+}
+
+uint64_t fnv1a(uint64_t h, const std::string &s) {
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  h *= 1099511628211ULL; // 相当于追加一个 '\0' 分隔符
+  return h;
+}
+
+} // namespace
+
+uint64_t RouteMatcher::pagesHash() const {
+  std::vector<std::string> files;
+  std::error_code ec;
+  if (std::filesystem::exists(pagesDir_, ec)) {
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator(pagesDir_, ec)) {
+      if (ec) {
+        break;
+      }
+      if (entry.is_regular_file(ec) && isPageSource(entry.path().string())) {
+        files.push_back(
+            entry.path().lexically_relative(pagesDir_).generic_string());
+      }
+    }
+  }
+  std::sort(files.begin(), files.end());
+  uint64_t h = 1469598103934665603ULL;
+  for (const auto &f : files) {
+    h = fnv1a(h, f);
+  }
+  return h;
+}
+
+bool RouteMatcher::writeManifest(const std::string &outPath) {
+  const std::vector<RoutePtr> routes = currentRoutes();
+
+  std::vector<ManifestRoute> records;
+  std::vector<ManifestSegment> segments;
+  std::string strings;
+  auto addString = [&strings](const std::string &s, uint32_t &off,
+                              uint32_t &len) {
+    off = static_cast<uint32_t>(strings.size());
+    len = static_cast<uint32_t>(s.size());
+    strings += s;
+  };
+
+  records.reserve(routes.size());
+  for (const auto &r : routes) {
+    ManifestRoute rec{};
+    addString(r->path, rec.pathOff, rec.pathLen);
+    const std::filesystem::path rel =
+        std::filesystem::path(r->filePath).lexically_relative(pagesDir_);
+    if (!rel.empty() && *rel.begin() != "..") {
+      rec.flags |= kRouteRelativeFile;
+      addString(rel.generic_string(), rec.fileOff, rec.fileLen);
+    } else {
+      addString(r->filePath, rec.fileOff, rec.fileLen);
+    }
+    rec.firstSegment = static_cast<uint32_t>(segments.size());
+    rec.segmentCount = static_cast<uint32_t>(r->segments.size());
+    for (const auto &seg : r->segments) {
+      ManifestSegment s{};
+      s.kind = static_cast<uint32_t>(seg.kind);
+      addString(seg.text, s.textOff, s.textLen);
+      segments.push_back(s);
+    }
+    records.push_back(rec);
+  }
+
+  ManifestHeader header{};
+  std::memcpy(header.magic, kManifestMagic, sizeof(header.magic));
+  header.version = kManifestVersion;
+  header.routeCount = static_cast<uint32_t>(records.size());
+  header.pagesHash = pagesHash();
+  header.segmentCount = static_cast<uint32_t>(segments.size());
+  header.stringBytes = static_cast<uint32_t>(strings.size());
+
+  // 先写临时文件再 rename，正在 mmap 旧清单的进程不受影响
+  std::error_code ec;
+  const std::filesystem::path out(outPath);
+  if (out.has_parent_path()) {
+    std::filesystem::create_directories(out.parent_path(), ec);
+  }
+  const std::string tmpPath = outPath + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.data()),
+               static_cast<std::streamsize>(records.size() * sizeof(ManifestRoute)));
+    file.write(reinterpret_cast<const char *>(segments.data()),
+               static_cast<std::streamsize>(segments.size() *
+                                            sizeof(ManifestSegment)));
+    file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    if (!file) {
+      return false;
+    }
+  }
+  std::filesystem::rename(tmpPath, out, ec);
+  if (ec) {
+    std::filesystem::remove(tmpPath, ec);
+    return false;
+  }
+  return true;
+}
+
+bool RouteMatcher::loadManifest(const std::string &manifestPath) {
+  MappedFile file;
+  if (!file.open(manifestPath) || file.size() < sizeof(ManifestHeader)) {
+    return false;
+  }
+  const unsigned char *base = file.data();
+  const auto header = readRecord<ManifestHeader>(base, 0);
+  if (std::memcmp(header.magic, kManifestMagic, sizeof(header.magic)) != 0 ||
+      header.version != kManifestVersion) {
+    return false;
+  }
+  const uint64_t routesOff = sizeof(ManifestHeader);
+  const uint64_t segmentsOff =
+      routesOff + uint64_t(header.routeCount) * sizeof(ManifestRoute);
+  const uint64_t stringsOff =
+      segmentsOff + uint64_t(header.segmentCount) * sizeof(ManifestSegment);
+  if (stringsOff + header.stringBytes != file.size()) {
+    return false;
+  }
+  if (header.pagesHash != pagesHash()) {
+    return false;
+  }
+
+  const char *strings = reinterpret_cast<const char *>(base + stringsOff);
+  auto stringAt = [&](uint32_t off, uint32_t len, std::string &out) {
+    if (uint64_t(off) + len > header.stringBytes) {
+      return false;
+    }
+    out.assign(strings + off, len);
+    return true;
+  };
+
+  // 清单里的段只用来校验：catch-all 与可选段只能在最后，且种类与文本要和
+  // 从 path 重新解析的结果一致（参数名错位会让匹配结果的键对不上）。任何一条
+  // 不符都当作清单损坏，退回全量扫描。按优先级顺序原地插入新树
+  auto table = std::make_unique<RouteTable>();
+  std::string segText;
+  for (uint32_t i = 0; i < header.routeCount; i++) {
+    const auto rec = readRecord<ManifestRoute>(
+        base, routesOff + uint64_t(i) * sizeof(ManifestRoute));
+    if (uint64_t(rec.firstSegment) + rec.segmentCount > header.segmentCount) {
+      return false;
+    }
+    auto r = std::make_shared<Route>();
+    std::string file;
+    if (!stringAt(rec.pathOff, rec.pathLen, r->path) ||
+        !stringAt(rec.fileOff, rec.fileLen, file)) {
+      return false;
+    }
+    r->filePath = (rec.flags & kRouteRelativeFile)
+                      ? (std::filesystem::path(pagesDir_) / file).string()
+                      : file;
+    r->isDynamic = r->path.find('[') != std::string::npos;
+    if (!parseRoutePattern(r->path, r->segments, r->paramNames,
+                           r->paramKinds) ||
+        r->segments.size() != rec.segmentCount) {
+      return false;
+    }
+    for (uint32_t s = 0; s < rec.segmentCount; s++) {
+      const auto seg = readRecord<ManifestSegment>(
+          base, segmentsOff +
+                    uint64_t(rec.firstSegment + s) * sizeof(ManifestSegment));
+      if (seg.kind > static_cast<uint32_t>(RouteSegmentKind::OptionalCatchAll) ||
+          !stringAt(seg.textOff, seg.textLen, segText)) {
+        return false;
+      }
+      const auto kind = static_cast<RouteSegmentKind>(seg.kind);
+      if (kind != RouteSegmentKind::Static &&
+          kind != RouteSegmentKind::Dynamic && s + 1 != rec.segmentCount) {
+        return false;
+      }
+      if (kind != r->segments[s].kind || segText != r->segments[s].text) {
+        return false;
+      }
+    }
+    r->id = nextRouteId_.fetch_add(1, std::memory_order_relaxed);
+    insertRoute(*table, r, true);
+  }
+
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  table->rules = table_.load(std::memory_order_acquire)->rules;
+  publish(std::move(table));
+  return true;
+}
@@ -5,72 +5,438 @@
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
-RouteMatcher::RouteMatcher(const std::string &pagesDir) : pagesDir_(pagesDir) {
+RouteMatcher::RouteMatcher(const std::string &pagesDir, size_t cacheCapacity,
+                           const std::string &manifestPath)
+    : pagesDir_(pagesDir), cache_(cacheCapacity) {
+  table_.store(new RouteTable(), std::memory_order_release);
+  if (!manifestPath.empty() && loadManifest(manifestPath)) {
+    loadedFromManifest_ = true;
+    return;
+  }
   scanFilesystem();
 }
 
-static int segmentRank(RouteSegmentKind k) {
-  switch (k) {
-  case RouteSegmentKind::Static:
-    return 4;
-  case RouteSegmentKind::Dynamic:
-    return 3;
+RouteMatcher::~RouteMatcher() { delete table_.load(std::memory_order_acquire); }
+
+void RouteStats::record(bool cacheHit, int64_t nanos) const {
+  static std::atomic<size_t> next{0};
+  thread_local const size_t index =
+      next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+  Slot &slot = slots[index];
+  slot.matches.fetch_add(1, std::memory_order_relaxed);
+  if (!cacheHit) {
+    slot.cacheMisses.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (nanos < 0) {
+    return;
+  }
+  size_t bucket = 0;
+  while (bucket < kBuckets - 1 &&
+         static_cast<uint64_t>(nanos) >= kBucketLimits[bucket]) {
+    bucket++;
+  }
+  slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  slot.sampled.fetch_add(1, std::memory_order_relaxed);
+  slot.nanos.fetch_add(static_cast<uint64_t>(nanos), std::memory_order_relaxed);
+}
+
+RouteStats::Snapshot RouteStats::snapshot() const {
+  Snapshot s;
+  for (const auto &slot : slots) {
+    const uint64_t matches = slot.matches.load(std::memory_order_relaxed);
+    const uint64_t misses = slot.cacheMisses.load(std::memory_order_relaxed);
+    s.matches += matches;
+    s.cacheHits += matches > misses ? matches - misses : 0;
+    s.sampled += slot.sampled.load(std::memory_order_relaxed);
+    s.nanos += slot.nanos.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < kBuckets; b++) {
+      s.buckets[b] += slot.buckets[b].load(std::memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+class RouteMatcher::ReadGuard {
+public:
+  explicit ReadGuard(RouteMatcher &m) : slot_(m.readers_[slotIndex()]) {
+    // 先登记再读指针；登记后发现 epoch 已翻转就换到新的一组重来，
+    // 保证留在旧组里的读者一定早于翻转，写方等旧组排空即可释放旧表
+    while (true) {
+      const uint64_t e = m.epoch_.load(std::memory_order_seq_cst);
+      parity_ = e & 1;
+      slot_.active[parity_].fetch_add(1, std::memory_order_seq_cst);
+      if (m.epoch_.load(std::memory_order_seq_cst) == e) {
+        break;
+      }
+      slot_.active[parity_].fetch_sub(1, std::memory_order_release);
+    }
+    table_ = m.table_.load(std::memory_order_seq_cst);
+  }
+  ~ReadGuard() {
+    slot_.active[parity_].fetch_sub(1, std::memory_order_release);
+  }
+  ReadGuard(const ReadGuard &) = delete;
+  ReadGuard &operator=(const ReadGuard &) = delete;
+
+  const RouteTable &table() const { return *table_; }
+
+private:
+  static size_t slotIndex() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t index =
+        next.fetch_add(1, std::memory_order_relaxed) % kReaderSlots;
+    return index;
+  }
+
+  ReaderSlot &slot_;
+  size_t parity_ = 0;
+  const RouteTable *table_ = nullptr;
+};
+
+bool splitUrl(std::string_view url, UrlSegments &out) {
+  out.url = url;
+  out.segs.clear();
+  if (url.empty() || url[0] != '/') {
+    return false;
+  }
+  if (url.size() == 1) {
+    return true;
+  }
+  size_t i = 1;
+  while (true) {
+    size_t j = url.find('/', i);
+    if (j == std::string_view::npos) {
+      out.segs.emplace_back(static_cast<uint32_t>(i),
+                            static_cast<uint32_t>(url.size()));
+      break;
+    }
+    out.segs.emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+    i = j + 1;
+  }
+  return true;
+}
+
+namespace {
+
+template <typename Children>
+auto lowerBoundChild(Children &children, std::string_view text) {
+  return std::lower_bound(
+      children.begin(), children.end(), text,
+      [](const auto &child, std::string_view t) { return child.first < t; });
+}
+
+const RouteTrieNode *findStaticChild(const RouteTrieNode &node,
+                                     std::string_view text) {
+  auto it = lowerBoundChild(node.staticChildren, text);
+  if (it == node.staticChildren.end() || it->first != text) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+const Route *firstOf(const std::vector<RoutePtr> &slot) {
+  return slot.empty() ? nullptr : slot.front().get();
+}
+
+// 深度优先回溯；caps 按段深度记录捕获区间
+const Route *matchNode(const RouteTrieNode &node, const UrlSegments &u,
+                       size_t depth, std::vector<ParamSpan> &caps) {
+  const size_t count = u.segs.size();
+  if (depth == count) {
+    if (const Route *r = firstOf(node.terminal)) {
+      return r;
+    }
+    caps[depth] = ParamSpan{};
+    if (const Route *r = firstOf(node.optionalDynamic)) {
+      return r;
+    }
+    return firstOf(node.optionalCatchAll);
+  }
+
+  const uint32_t b = u.segs[depth].first;
+  const uint32_t e = u.segs[depth].second;
+  if (e > b) {
+    const std::string_view seg = u.url.substr(b, e - b);
+    if (const RouteTrieNode *child = findStaticChild(node, seg)) {
+      if (const Route *r = matchNode(*child, u, depth + 1, caps)) {
+        return r;
+      }
+    }
+    if (node.dynamicChild) {
+      caps[depth] = ParamSpan{b, e, true};
+      if (const Route *r = matchNode(*node.dynamicChild, u, depth + 1, caps)) {
+        return r;
+      }
+    }
+    if (!node.optionalDynamic.empty() && depth + 1 == count) {
+      caps[depth] = ParamSpan{b, e, true};
+      return firstOf(node.optionalDynamic);
+    }
+  }
+
+  // catch-all 吞掉剩余全部内容（含 '/'），等价于 (.+)：非空且不含行终止符
+  if (!node.catchAll.empty() || !node.optionalCatchAll.empty()) {
+    const std::string_view rest = u.url.substr(b);
+    if (!rest.empty() && rest.find_first_of("\r\n") == std::string_view::npos) {
+      caps[depth] = ParamSpan{b, static_cast<uint32_t>(u.url.size()), true};
+      return node.catchAll.empty() ? firstOf(node.optionalCatchAll)
+                                   : firstOf(node.catchAll);
+    }
+  }
+  return nullptr;
+}
+
+bool sameEntry(const Route &a, const Route &b) {
+  return a.filePath == b.filePath && a.path == b.path;
+}
+
+// 同一槽位按 path、filePath 排序；同一文件重复加入视为无变化
+bool insertSorted(std::vector<RoutePtr> &slot, const RoutePtr &route) {
+  auto it = std::lower_bound(
+      slot.begin(), slot.end(), route, [](const RoutePtr &a, const RoutePtr &b) {
+        if (a->path != b->path) {
+          return a->path < b->path;
+        }
+        return a->filePath < b->filePath;
+      });
+  if (it != slot.end() && sameEntry(**it, *route)) {
+    return false;
+  }
+  slot.insert(it, route);
+  return true;
+}
+
+bool eraseFrom(std::vector<RoutePtr> &slot, const Route &key) {
+  for (auto it = slot.begin(); it != slot.end(); ++it) {
+    if (sameEntry(**it, key)) {
+      slot.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<RoutePtr> &slotFor(RouteTrieNode &node, RouteSegmentKind kind) {
+  switch (kind) {
   case RouteSegmentKind::OptionalDynamic:
-    return 2;
+    return node.optionalDynamic;
   case RouteSegmentKind::CatchAll:
-    return 1;
+    return node.catchAll;
   case RouteSegmentKind::OptionalCatchAll:
-    return 0;
+    return node.optionalCatchAll;
+  default:
+    return node.terminal;
   }
-  return 0;
-}
-
-static void appendRegexEscaped(std::string &out, const std::string &s) {
-  for (char c : s) {
-    switch (c) {
-    case '\\':
-    case '.':
-    case '^':
-    case '$':
-    case '|':
-    case '(':
-    case ')':
-    case '[':
-    case ']':
-    case '{':
-    case '}':
-    case '*':
-    case '+':
-    case '?':
-      out.push_back('\\');
-      out.push_back(c);
+}
+
+// inPlace 只用于尚未发布的新树；否则沿途复制节点，已发布的节点保持不变
+bool insertAt(std::shared_ptr<RouteTrieNode> &node, const RoutePtr &route,
+              size_t depth, bool inPlace) {
+  std::shared_ptr<RouteTrieNode> fresh =
+      !node     ? std::make_shared<RouteTrieNode>()
+      : inPlace ? node
+                : std::make_shared<RouteTrieNode>(*node);
+  const auto &segments = route->segments;
+  bool changed = false;
+  if (depth == segments.size()) {
+    changed = insertSorted(fresh->terminal, route);
+  } else {
+    const RouteSegment &seg = segments[depth];
+    switch (seg.kind) {
+    case RouteSegmentKind::Static: {
+      auto &children = fresh->staticChildren;
+      auto it = lowerBoundChild(children, seg.text);
+      if (it == children.end() || it->first != seg.text) {
+        std::shared_ptr<RouteTrieNode> child;
+        changed = insertAt(child, route, depth + 1, inPlace);
+        children.emplace(it, seg.text, std::move(child));
+      } else {
+        changed = insertAt(it->second, route, depth + 1, inPlace);
+      }
+      break;
+    }
+    case RouteSegmentKind::Dynamic:
+      changed = insertAt(fresh->dynamicChild, route, depth + 1, inPlace);
       break;
     default:
-      out.push_back(c);
+      changed = insertSorted(slotFor(*fresh, seg.kind), route);
       break;
     }
   }
+  if (changed) {
+    node = std::move(fresh);
+  }
+  return changed;
+}
+
+// 删除后变空的节点直接摘掉
+bool eraseAt(std::shared_ptr<RouteTrieNode> &node, const Route &key,
+             size_t depth) {
+  if (!node) {
+    return false;
+  }
+  auto fresh = std::make_shared<RouteTrieNode>(*node);
+  const auto &segments = key.segments;
+  if (depth == segments.size()) {
+    if (!eraseFrom(fresh->terminal, key)) {
+      return false;
+    }
+  } else {
+    const RouteSegment &seg = segments[depth];
+    switch (seg.kind) {
+    case RouteSegmentKind::Static: {
+      auto &children = fresh->staticChildren;
+      auto it = lowerBoundChild(children, seg.text);
+      if (it == children.end() || it->first != seg.text ||
+          !eraseAt(it->second, key, depth + 1)) {
+        return false;
+      }
+      if (!it->second) {
+        children.erase(it);
+      }
+      break;
+    }
+    case RouteSegmentKind::Dynamic:
+      if (!eraseAt(fresh->dynamicChild, key, depth + 1)) {
+        return false;
+      }
+      break;
+    default:
+      if (!eraseFrom(slotFor(*fresh, seg.kind), key)) {
+        return false;
+      }
+      break;
+    }
+  }
+  node = fresh->empty() ? nullptr : std::move(fresh);
+  return true;
+}
+
+} // namespace
+
+// 按匹配优先级顺序收集：先本节点槽位，再静态子节点，最后动态子节点
+void RouteMatcher::collectRoutes(const RouteTrieNode &node,
+                                 std::vector<RoutePtr> &out) {
+  out.insert(out.end(), node.terminal.begin(), node.terminal.end());
+  for (const auto &child : node.staticChildren) {
+    collectRoutes(*child.second, out);
+  }
+  if (node.dynamicChild) {
+    collectRoutes(*node.dynamicChild, out);
+  }
+  for (const auto *slot :
+       {&node.optionalDynamic, &node.catchAll, &node.optionalCatchAll}) {
+    out.insert(out.end(), slot->begin(), slot->end());
+  }
+}
+
+std::vector<RoutePtr> RouteMatcher::currentRoutes() {
+  ReadGuard guard(*this);
+  std::vector<RoutePtr> routes;
+  if (guard.table().root) {
+    collectRoutes(*guard.table().root, routes);
+  }
+  return routes;
+}
+
+bool RouteMatcher::isPageSource(const std::string &path) {
+  const auto ext = std::filesystem::path(path).extension().string();
+  return ext == ".js" || ext == ".jsx" || ext == ".ts" || ext == ".tsx" ||
+         ext == ".cjs";
+}
+
+RoutePtr RouteMatcher::makeRoute(const std::string &route,
+                                 const std::string &filePath) {
+  auto r = std::make_shared<Route>();
+  r->path = route;
+  r->filePath = filePath;
+  r->isDynamic = route.find('[') != std::string::npos;
+  if (!parseRoutePattern(route, r->segments, r->paramNames, r->paramKinds)) {
+    return nullptr;
+  }
+  r->id = nextRouteId_.fetch_add(1, std::memory_order_relaxed);
+  return r;
+}
+
+bool RouteMatcher::insertRoute(RouteTable &table, const RoutePtr &route,
+                               bool inPlace) {
+  if (!table.root) {
+    table.root = std::make_shared<RouteTrieNode>();
+  }
+  if (!insertAt(table.root, route, 0, inPlace)) {
+    return false;
+  }
+  table.routeCount++;
+  return true;
+}
+
+bool RouteMatcher::eraseRoute(RouteTable &table, const Route &key) {
+  if (!eraseAt(table.root, key, 0)) {
+    return false;
+  }
+  if (!table.root) {
+    table.root = std::make_shared<RouteTrieNode>();
+  }
+  table.routeCount--;
+  return true;
 }
 
 void RouteMatcher::addRoute(const std::string &route,
                             const std::string &filePath) {
-  Route r;
-  r.path = route;
-  r.filePath = filePath;
-  r.isDynamic = route.find('[') != std::string::npos;
-
-  bool valid = true;
-  r.regexPattern =
-      compileRoutePattern(route, r.segments, r.paramNames, r.paramKinds, valid);
-  if (!valid) {
+  RoutePtr r = makeRoute(route, filePath);
+  if (!r) {
     return;
   }
-  routes_.push_back(r);
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_unique<RouteTable>(*table_.load(std::memory_order_acquire));
+  if (insertRoute(*next, r, false)) {
+    publish(std::move(next));
+  }
+}
+
+void RouteMatcher::publish(std::unique_ptr<RouteTable> table) {
+  if (!table->root) {
+    table->root = std::make_shared<RouteTrieNode>();
+  }
+  table->generation = ++generation_;
+  const RouteTable *old =
+      table_.exchange(table.release(), std::memory_order_seq_cst);
+  const size_t parity = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+  for (auto &slot : readers_) {
+    while (slot.active[parity].load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+  }
+  delete old;
+}
+
+const Route *RouteMatcher::findRoute(const RouteTable &table,
+                                     std::string_view url,
+                                     std::vector<ParamSpan> &spans) {
+  spans.clear();
+  UrlSegments u;
+  if (!table.root || !splitUrl(url, u)) {
+    return nullptr;
+  }
+  std::vector<ParamSpan> caps(u.segs.size() + 1);
+  const Route *route = matchNode(*table.root, u, 0, caps);
+  if (!route) {
+    return nullptr;
+  }
+  const auto &segments = route->segments;
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (segments[i].kind != RouteSegmentKind::Static) {
+      spans.push_back(caps[i]);
+    }
+  }
+  return route;
 }
 
 std::pair<bool, std::unordered_map<std::string, std::optional<std::string>>>
@@ -79,162 +445,358 @@ RouteMatcher::match(const std::string &url) {
   return {result.matched, std::move(result.params)};
 }
 
-MatchResult RouteMatcher::matchRoute(const std::string &url) {
-  MatchResult result;
-  result.matched = false;
+const Route *RouteMatcher::lookupRoute(const RouteTable &table,
+                                       std::string_view url,
+                                       std::vector<ParamSpan> &spans) {
+  // 随机采样，避免固定间隔和请求序列的周期重合
+  thread_local uint32_t rng = 0x9e3779b9u;
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  const bool sample = rng % RouteStats::kSampleEvery == 0;
+  const auto start = sample ? std::chrono::steady_clock::now()
+                            : std::chrono::steady_clock::time_point();
+  const void *cached = nullptr;
+  const bool hit = cache_.lookup(url, table.generation, cached, spans);
+  const Route *route = nullptr;
+  if (hit) {
+    route = static_cast<const Route *>(cached);
+  } else {
+    route = findRoute(table, url, spans);
+    cache_.insert(url, table.generation, route, spans);
+  }
+  if (route) {
+    route->stats.record(
+        hit, sample ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count()
+                    : -1);
+  }
+  return route;
+}
 
-  auto cacheIt = routeCache_.find(url);
-  if (cacheIt != routeCache_.end()) {
-    const auto &route = cacheIt->second;
-    if (!route.isDynamic) {
-      if (route.path == url) {
-        result.matched = true;
-        result.filePath = route.filePath;
-        return result;
-      }
-    } else {
-      std::smatch matches;
-      if (std::regex_match(url, matches, route.regexPattern)) {
-        result.matched = true;
-        result.filePath = route.filePath;
-        for (size_t i = 0; i < route.paramNames.size(); i++) {
-          if (i + 1 < matches.size()) {
-            if (matches[i + 1].matched) {
-              result.params[route.paramNames[i]] = matches[i + 1].str();
-            } else if (i < route.paramKinds.size() &&
-                       route.paramKinds[i] ==
-                           RouteSegmentKind::OptionalDynamic) {
-              result.params[route.paramNames[i]] = std::nullopt;
-            }
-          }
-        }
-        return result;
-      }
+std::vector<std::pair<RoutePtr, RouteStats::Snapshot>>
+RouteMatcher::routeStats() {
+  std::vector<std::pair<RoutePtr, RouteStats::Snapshot>> out;
+  for (auto &r : currentRoutes()) {
+    auto snapshot = r->stats.snapshot();
+    out.emplace_back(std::move(r), snapshot);
+  }
+  return out;
+}
+
+uint32_t RouteMatcher::matchSpans(std::string_view url,
+                                  std::vector<ParamSpan> &spans,
+                                  RoutePtr *route) {
+  ReadGuard guard(*this);
+  const Route *r = lookupRoute(guard.table(), url, spans);
+  if (!r) {
+    return 0;
+  }
+  if (route) {
+    *route = r->shared_from_this();
+  }
+  return r->id;
+}
+
+BatchMatchResult
+RouteMatcher::matchMany(const std::vector<std::string_view> &urls,
+                        unsigned threads) {
+  constexpr size_t kMinPerThread = 2048;
+  const size_t n = urls.size();
+  BatchMatchResult out;
+  out.routeIds.assign(n, 0);
+  out.spanOffsets.assign(n + 1, 0);
+
+  // 调用线程持有读者登记直到所有工作线程结束，快照在整批期间不会被释放
+  ReadGuard guard(*this);
+  const RouteTable &table = guard.table();
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const size_t chunks = std::max<size_t>(
+      1, std::min<size_t>(threads, n / kMinPerThread));
+  const size_t perChunk = (n + chunks - 1) / chunks;
+  std::vector<const Route *> matched(n, nullptr);
+  std::vector<std::vector<ParamSpan>> chunkSpans(chunks);
+
+  auto work = [&](size_t c) {
+    std::vector<ParamSpan> spans;
+    const size_t end = std::min(n, (c + 1) * perChunk);
+    for (size_t i = c * perChunk; i < end; i++) {
+      matched[i] = findRoute(table, urls[i], spans);
+      out.spanOffsets[i + 1] = static_cast<uint32_t>(spans.size());
+      chunkSpans[c].insert(chunkSpans[c].end(), spans.begin(), spans.end());
     }
-    routeCache_.erase(cacheIt);
+  };
+  std::vector<std::thread> workers;
+  for (size_t c = 1; c < chunks; c++) {
+    workers.emplace_back(work, c);
+  }
+  work(0);
+  for (auto &t : workers) {
+    t.join();
   }
 
-  for (const auto &route : routes_) {
-    if (!route.isDynamic) {
-      if (route.path == url) {
-        result.matched = true;
-        result.filePath = route.filePath;
-        routeCache_[url] = route;
-        return result;
+  for (size_t i = 0; i < n; i++) {
+    out.spanOffsets[i + 1] += out.spanOffsets[i];
+  }
+  out.spans.reserve(out.spanOffsets[n]);
+  for (auto &spans : chunkSpans) {
+    out.spans.insert(out.spans.end(), spans.begin(), spans.end());
+  }
+  std::unordered_set<uint32_t> seen;
+  for (size_t i = 0; i < n; i++) {
+    if (const Route *r = matched[i]) {
+      out.routeIds[i] = r->id;
+      if (seen.insert(r->id).second) {
+        out.routes.push_back(r->shared_from_this());
       }
-      continue;
     }
+  }
+  return out;
+}
 
-    std::smatch matches;
-    if (!std::regex_match(url, matches, route.regexPattern)) {
-      continue;
+bool RouteMatcher::resolve(std::string_view url, RouteResolution &out,
+                           bool wantRoute) {
+  out.headers.clear();
+  out.redirectStatus = 0;
+  out.location.clear();
+  out.rewritten = false;
+  out.url.clear();
+  out.routeId = 0;
+  out.spans.clear();
+  out.route.reset();
+
+  ReadGuard guard(*this);
+  const RouteTable &table = guard.table();
+  const bool hit = table.rules && applyRules(*table.rules, url, out);
+  if (out.redirectStatus != 0) {
+    return true;
+  }
+  const std::string_view target =
+      out.rewritten ? std::string_view(out.url) : url;
+  if (const Route *r = lookupRoute(table, target, out.spans)) {
+    out.routeId = r->id;
+    if (wantRoute) {
+      out.route = r->shared_from_this();
     }
+  }
+  return hit;
+}
 
-    result.matched = true;
-    result.filePath = route.filePath;
-    for (size_t i = 0; i < route.paramNames.size(); i++) {
-      if (i + 1 < matches.size()) {
-        if (matches[i + 1].matched) {
-          result.params[route.paramNames[i]] = matches[i + 1].str();
-        } else if (i < route.paramKinds.size() &&
-                   route.paramKinds[i] == RouteSegmentKind::OptionalDynamic) {
-          result.params[route.paramNames[i]] = std::nullopt;
-        }
-      }
-    }
-    routeCache_[url] = route;
+MatchResult RouteMatcher::matchRoute(const std::string &url) {
+  MatchResult result;
+  result.matched = false;
+
+  ReadGuard guard(*this);
+  std::vector<ParamSpan> spans;
+  const Route *route = lookupRoute(guard.table(), url, spans);
+  if (!route) {
     return result;
   }
 
+  result.matched = true;
+  result.filePath = route->filePath;
+  for (size_t i = 0; i < route->paramNames.size(); i++) {
+    if (spans[i].matched) {
+      result.params[route->paramNames[i]] =
+          url.substr(spans[i].begin, spans[i].end - spans[i].begin);
+    } else if (route->paramKinds[i] == RouteSegmentKind::OptionalDynamic) {
+      result.params[route->paramNames[i]] = std::nullopt;
+    }
+  }
   return result;
 }
 
+// 文件路径 -> 路由路径，规则与全量扫描一致；normalizedPath 统一成 pagesDir/rel
+bool RouteMatcher::routeForFile(const std::string &filePath, std::string &route,
+                                std::string &normalizedPath) const {
+  const std::filesystem::path path(filePath);
+  if (!isPageSource(filePath)) {
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::path rel = std::filesystem::relative(path, pagesDir_, ec);
+  if (ec || rel.empty() || *rel.begin() == "..") {
+    return false;
+  }
+  normalizedPath = (std::filesystem::path(pagesDir_) / rel).string();
+
+  rel.replace_extension("");
+  route = rel.generic_string();
+  if (route == "index") {
+    route = "";
+  }
+  if (route.size() >= 6 && route.substr(route.size() - 6) == "/index") {
+    route = route.substr(0, route.size() - 6);
+  }
+
+  route = "/" + route;
+  if (route.size() > 1 && route.back() == '/') {
+    route.pop_back();
+  }
+  return true;
+}
+
 void RouteMatcher::scanFilesystem() {
-  routes_.clear();
-  routeCache_.clear();
+  // 沿用已有的 Route 对象，全量重扫后 id 不变
+  std::unordered_map<std::string, RoutePtr> previous;
+  for (auto &r : currentRoutes()) {
+    previous.emplace(r->filePath, std::move(r));
+  }
 
+  auto table = std::make_unique<RouteTable>();
   std::error_code ec;
-  if (!std::filesystem::exists(pagesDir_, ec)) {
-    return;
+  if (std::filesystem::exists(pagesDir_, ec)) {
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator(pagesDir_, ec)) {
+      if (ec) {
+        break;
+      }
+      if (!entry.is_regular_file(ec)) {
+        continue;
+      }
+      std::string route;
+      std::string filePath;
+      if (!routeForFile(entry.path().string(), route, filePath)) {
+        continue;
+      }
+      auto it = previous.find(filePath);
+      RoutePtr r = it != previous.end() && it->second->path == route
+                       ? it->second
+                       : makeRoute(route, filePath);
+      if (r) {
+        insertRoute(*table, r, true);
+      }
+    }
   }
 
-  for (const auto &entry :
-       std::filesystem::recursive_directory_iterator(pagesDir_, ec)) {
-    if (ec) {
-      break;
-    }
-    if (!entry.is_regular_file(ec)) {
-      continue;
-    }
+  // 新表在锁外建好，发布只是一次指针交换
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  table->rules = table_.load(std::memory_order_acquire)->rules;
+  publish(std::move(table));
+}
 
-    const auto path = entry.path();
-    const auto ext = path.extension().string();
-    if (ext != ".js" && ext != ".jsx" && ext != ".ts" && ext != ".tsx" &&
-        ext != ".cjs") {
-      continue;
-    }
+bool RouteMatcher::addFile(const std::string &filePath) {
+  std::string route;
+  std::string normalized;
+  if (!routeForFile(filePath, route, normalized)) {
+    return false;
+  }
+  RoutePtr r = makeRoute(route, normalized);
+  if (!r) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_unique<RouteTable>(*table_.load(std::memory_order_acquire));
+  if (!insertRoute(*next, r, false)) {
+    return false;
+  }
+  publish(std::move(next));
+  return true;
+}
 
-    std::filesystem::path rel = std::filesystem::relative(path, pagesDir_, ec);
-    if (ec) {
-      continue;
+bool RouteMatcher::removeFile(const std::string &filePath) {
+  Route key;
+  if (!routeForFile(filePath, key.path, key.filePath) ||
+      !parseRoutePattern(key.path, key.segments, key.paramNames,
+                         key.paramKinds)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_unique<RouteTable>(*table_.load(std::memory_order_acquire));
+  if (!eraseRoute(*next, key)) {
+    return false;
+  }
+  publish(std::move(next));
+  return true;
+}
+
+// 单个变更路径：文件存在就加入，不存在就删除；目录事件（新建、移入、删除）
+// 退化为只重扫该子树
+bool RouteMatcher::applyFileChange(RouteTable &table, const std::string &path) {
+  std::error_code ec;
+  const auto st = std::filesystem::status(path, ec);
+  std::string route;
+  std::string normalized;
+
+  if (std::filesystem::is_regular_file(st)) {
+    if (!routeForFile(path, route, normalized)) {
+      return false;
     }
+    RoutePtr r = makeRoute(route, normalized);
+    return r && insertRoute(table, r, false);
+  }
 
-    rel.replace_extension("");
-    std::string route = rel.generic_string();
-    if (route == "index") {
-      route = "";
+  if (!std::filesystem::is_directory(st) && isPageSource(path)) {
+    Route key;
+    return routeForFile(path, key.path, key.filePath) &&
+           parseRoutePattern(key.path, key.segments, key.paramNames,
+                             key.paramKinds) &&
+           eraseRoute(table, key);
+  }
+
+  std::filesystem::path rel = std::filesystem::relative(path, pagesDir_, ec);
+  if (ec || rel.empty() || *rel.begin() == "..") {
+    return false;
+  }
+  const std::string prefix =
+      (std::filesystem::path(pagesDir_) / rel).string() + "/";
+  bool changed = false;
+  std::vector<RoutePtr> existing;
+  collectRoutes(*table.root, existing);
+  for (const auto &r : existing) {
+    if (r->filePath.compare(0, prefix.size(), prefix) == 0) {
+      changed = eraseRoute(table, *r) || changed;
     }
-    if (route.size() >= 6 && route.substr(route.size() - 6) == "/index") {
-      route = route.substr(0, route.size() - 6);
+  }
+  if (std::filesystem::is_directory(st)) {
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator(path, ec)) {
+      if (ec) {
+        break;
+      }
+      if (entry.is_regular_file(ec) &&
+          routeForFile(entry.path().string(), route, normalized)) {
+        RoutePtr r = makeRoute(route, normalized);
+        changed = (r && insertRoute(table, r, false)) || changed;
+      }
     }
+  }
+  return changed;
+}
 
-    route = "/" + route;
-    if (route.size() > 1 && route.back() == '/') {
-      route.pop_back();
+bool RouteMatcher::applyChanges(const std::vector<std::string> &paths) {
+  for (const auto &path : paths) {
+    std::error_code ec;
+    if (std::filesystem::equivalent(path, pagesDir_, ec)) {
+      scanFilesystem();
+      return true;
     }
+  }
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next = std::make_unique<RouteTable>(*table_.load(std::memory_order_acquire));
+  bool changed = false;
+  for (const auto &path : paths) {
+    changed = applyFileChange(*next, path) || changed;
+  }
+  if (changed) {
+    publish(std::move(next));
+  }
+  return changed;
+}
 
-    addRoute(route, path.string());
-  }
-
-  std::sort(routes_.begin(), routes_.end(),
-            [](const Route &a, const Route &b) -> bool {
-              const size_t al = a.segments.size();
-              const size_t bl = b.segments.size();
-              const size_t ml = std::min(al, bl);
-              for (size_t i = 0; i < ml; i++) {
-                const auto ak = a.segments[i].kind;
-                const auto bk = b.segments[i].kind;
-                const int ar = segmentRank(ak);
-                const int br = segmentRank(bk);
-                if (ar != br) {
-                  return ar > br;
-                }
-                if (ak == RouteSegmentKind::Static &&
-                    bk == RouteSegmentKind::Static) {
-                  if (a.segments[i].text != b.segments[i].text) {
-                    return a.segments[i].text < b.segments[i].text;
-                  }
-                }
-              }
-              if (al != bl) {
-                return al < bl;
-              }
-              return a.path < b.path;
-            });
-}
-
-std::regex RouteMatcher::compileRoutePattern(
+bool RouteMatcher::parseRoutePattern(
     const std::string &route, std::vector<RouteSegment> &outSegments,
     std::vector<std::string> &outParamNames,
-    std::vector<RouteSegmentKind> &outParamKinds, bool &outValid) {
+    std::vector<RouteSegmentKind> &outParamKinds) {
   outSegments.clear();
   outParamNames.clear();
   outParamKinds.clear();
-  outValid = true;
 
   if (route.empty() || route[0] != '/') {
-    outValid = false;
-    return std::regex();
+    return false;
   }
 
   std::vector<std::string> segs;
@@ -255,13 +817,8 @@ std::regex RouteMatcher::compileRoutePattern(
     }
   }
 
-  std::string pattern;
-  pattern.reserve(route.size() * 2 + 16);
-  pattern.append("^");
-
   if (segs.empty()) {
-    pattern.append("/$");
-    return std::regex(pattern);
+    return true;
   }
 
   for (size_t idx = 0; idx < segs.size(); idx++) {
@@ -271,84 +828,61 @@ std::regex RouteMatcher::compileRoutePattern(
     if (seg.size() >= 6 && seg.rfind("[[...", 0) == 0 &&
         seg.substr(seg.size() - 2) == "]]") {
       if (!isLast) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       const std::string inner = seg.substr(2, seg.size() - 4);
       const std::string name = inner.size() > 3 ? inner.substr(3) : std::string();
       if (name.empty()) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       outSegments.push_back({RouteSegmentKind::OptionalCatchAll, name});
       outParamNames.push_back(name);
       outParamKinds.push_back(RouteSegmentKind::OptionalCatchAll);
-      if (segs.size() == 1) {
-        pattern.append("/(?:(.+))?");
-      } else {
-        pattern.append("(?:/(.+))?");
-      }
       continue;
     }
 
     if (seg.size() >= 4 && seg.rfind("[[", 0) == 0 &&
         seg.substr(seg.size() - 2) == "]]") {
       if (!isLast) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       const std::string name = seg.substr(2, seg.size() - 4);
       if (name.empty()) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       outSegments.push_back({RouteSegmentKind::OptionalDynamic, name});
       outParamNames.push_back(name);
       outParamKinds.push_back(RouteSegmentKind::OptionalDynamic);
-      if (segs.size() == 1) {
-        pattern.append("/(?:([^/]+))?");
-      } else {
-        pattern.append("(?:/([^/]+))?");
-      }
       continue;
     }
 
-    pattern.push_back('/');
-
     if (seg.size() >= 5 && seg.rfind("[...", 0) == 0 && seg.back() == ']') {
       if (!isLast) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       const std::string name = seg.substr(4, seg.size() - 5);
       if (name.empty()) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       outSegments.push_back({RouteSegmentKind::CatchAll, name});
       outParamNames.push_back(name);
       outParamKinds.push_back(RouteSegmentKind::CatchAll);
-      pattern.append("(.+)");
       continue;
     }
 
     if (seg.size() >= 3 && seg.front() == '[' && seg.back() == ']') {
       const std::string name = seg.substr(1, seg.size() - 2);
       if (name.empty()) {
-        outValid = false;
-        return std::regex();
+        return false;
       }
       outSegments.push_back({RouteSegmentKind::Dynamic, name});
       outParamNames.push_back(name);
       outParamKinds.push_back(RouteSegmentKind::Dynamic);
-      pattern.append("([^/]+)");
       continue;
     }
 
     outSegments.push_back({RouteSegmentKind::Static, seg});
-    appendRegexEscaped(pattern, seg);
   }
 
-  pattern.append("$");
-  return std::regex(pattern);
+  return true;
 }
@@ -1,5 +1,11 @@
-#include <regex>
+#include "route_cache.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -18,39 +24,218 @@ struct RouteSegment {
   std::string text;
 };
 
-struct Route {
+// 单条路由的匹配计数。按线程散列到独占缓存行的槽里，各线程写自己的槽，
+// 读取时再汇总。读时钟比一次缓存命中还贵，耗时只对每线程每 kSampleEvery
+// 次匹配采样一次，平均值按采样次数算
+struct RouteStats {
+  static constexpr size_t kSlots = 8;
+  static constexpr uint32_t kSampleEvery = 8;
+  static constexpr size_t kBuckets = 6;
+  // 匹配耗时直方图各桶的上界（纳秒），最后一桶不设上界
+  static constexpr uint64_t kBucketLimits[kBuckets - 1] = {256, 1024, 4096,
+                                                           16384, 65536};
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> matches{0};
+    std::atomic<uint64_t> cacheMisses{0}; // 热路由几乎都命中，记未命中省一次原子加
+    std::atomic<uint64_t> sampled{0};
+    std::atomic<uint64_t> nanos{0};
+    std::atomic<uint64_t> buckets[kBuckets] = {};
+  };
+
+  struct Snapshot {
+    uint64_t matches = 0;
+    uint64_t cacheHits = 0;
+    uint64_t sampled = 0;
+    uint64_t nanos = 0; // 采样到的匹配耗时之和
+    uint64_t buckets[kBuckets] = {};
+  };
+
+  // nanos < 0 表示这次没有采样耗时
+  void record(bool cacheHit, int64_t nanos) const;
+  Snapshot snapshot() const;
+
+  mutable Slot slots[kSlots];
+};
+
+struct Route : std::enable_shared_from_this<Route> {
+  uint32_t id = 0; // 进程内唯一，增量更新时同一文件保持不变
   std::string path;
   std::string filePath;
   bool isDynamic;
   std::vector<RouteSegment> segments;
   std::vector<std::string> paramNames;
   std::vector<RouteSegmentKind> paramKinds;
-  std::regex regexPattern;
+  RouteStats stats; // 同一文件的 Route 在重扫后沿用，计数随之保留
 };
 
+using RoutePtr = std::shared_ptr<const Route>;
+
 struct MatchResult {
   bool matched;
   std::string filePath;
   std::unordered_map<std::string, std::optional<std::string>> params;
 };
 
+// URL 按 '/' 切分后的段区间；"/" 视为零段，"/a/" 末尾保留一个空段，
+// 与原先整串正则匹配的语义保持一致（不做尾斜杠归一化）
+struct UrlSegments {
+  std::string_view url;
+  std::vector<std::pair<uint32_t, uint32_t>> segs;
+};
+
+bool splitUrl(std::string_view url, UrlSegments &out);
+
+// 声明式的 redirect/rewrite/header 规则，source 用和页面文件相同的 [param] 语法，
+// destination 与 header 值里可以引用 source 的参数
+enum class RouteRuleKind {
+  Redirect,
+  Rewrite,
+  Header,
+};
+
+struct RouteRule {
+  RouteRuleKind kind = RouteRuleKind::Rewrite;
+  std::string source;
+  std::string destination;
+  int status = 307; // 仅 redirect
+  std::vector<std::pair<std::string, std::string>> headers; // 仅 header
+};
+
+// 编译后的规则集，随路由表快照一起发布（定义见 route_rules.cpp）
+struct RouteRuleSet;
+
+// 规则与页面匹配一次完成的结果。headers 是全部命中的 header 规则；
+// 命中 redirect 时不再做页面匹配；命中 rewrite 时页面按改写后的 url 匹配，
+// spans 也相对于它
+struct RouteResolution {
+  std::vector<std::pair<std::string, std::string>> headers;
+  int redirectStatus = 0;
+  std::string location;
+  bool rewritten = false;
+  std::string url;
+  uint32_t routeId = 0;
+  std::vector<ParamSpan> spans;
+  RoutePtr route;
+};
+
+// 批量匹配的列式结果：第 i 个 url 的参数区间是
+// spans[spanOffsets[i], spanOffsets[i + 1])，routes 是本批匹配到的路由（按 id 去重）
+struct BatchMatchResult {
+  std::vector<uint32_t> routeIds; // 0 表示不匹配
+  std::vector<uint32_t> spanOffsets;
+  std::vector<ParamSpan> spans;
+  std::vector<RoutePtr> routes;
+};
+
+// 路由前缀树：每层按 Static > Dynamic > OptionalDynamic > CatchAll >
+// OptionalCatchAll 的顺序尝试，与按 segmentRank 排序后线性扫描的结果一致。
+// 可选段和 catch-all 只能出现在末尾，所以直接挂在父节点上。
+// 同一位置可能有多条路由（[id] 与 [slug]、a.js 与 a.tsx），按 path、filePath
+// 排序，取第一条。已发布的节点不再修改，增量更新只复制根到改动处的路径。
+struct RouteTrieNode {
+  std::vector<std::pair<std::string, std::shared_ptr<RouteTrieNode>>>
+      staticChildren; // 按 text 排序，二分查找
+  std::shared_ptr<RouteTrieNode> dynamicChild;
+  std::vector<RoutePtr> terminal;
+  std::vector<RoutePtr> optionalDynamic;
+  std::vector<RoutePtr> catchAll;
+  std::vector<RoutePtr> optionalCatchAll;
+
+  bool empty() const {
+    return staticChildren.empty() && !dynamicChild && terminal.empty() &&
+           optionalDynamic.empty() && catchAll.empty() &&
+           optionalCatchAll.empty();
+  }
+};
+
+// 不可变路由表快照：在旁边建好后原子发布，读者不加锁
+struct RouteTable {
+  std::shared_ptr<RouteTrieNode> root;
+  std::shared_ptr<const RouteRuleSet> rules;
+  size_t routeCount = 0;
+  uint32_t generation = 0;
+};
+
 class RouteMatcher {
 public:
-  RouteMatcher(const std::string &pagesDir);
+  // manifestPath 非空且清单与 pages 目录一致时直接加载清单，否则全量扫描
+  RouteMatcher(const std::string &pagesDir, size_t cacheCapacity = 4096,
+               const std::string &manifestPath = std::string());
+  ~RouteMatcher();
+  RouteMatcher(const RouteMatcher &) = delete;
+  RouteMatcher &operator=(const RouteMatcher &) = delete;
+
   void addRoute(const std::string &route, const std::string &filePath);
   std::pair<bool, std::unordered_map<std::string, std::optional<std::string>>>
   match(const std::string &url);
   MatchResult matchRoute(const std::string &url);
+  // 快路径：只返回路由 id（0 表示不匹配）和参数在 url 中的字节区间，
+  // spans 按 paramNames 顺序；需要路由本身时通过 route 取回
+  uint32_t matchSpans(std::string_view url, std::vector<ParamSpan> &spans,
+                      RoutePtr *route = nullptr);
+  // 整批在同一份路由表快照上匹配，按 threads 切块并行；不读写结果缓存，
+  // 避免一次性的大批 url 把线上热点挤出去。threads 为 0 时取 CPU 核数
+  BatchMatchResult matchMany(const std::vector<std::string_view> &urls,
+                             unsigned threads = 0);
+  // 替换规则表；规则非法时返回 false 并在 error 中说明，原规则保持不变
+  bool setRules(const std::vector<RouteRule> &rules, std::string &error);
+  // 规则与页面匹配一起解析；返回是否命中了任何规则。wantRoute 时填 out.route
+  bool resolve(std::string_view url, RouteResolution &out,
+               bool wantRoute = false);
   void scanFilesystem();
+  // 按文件变更增量更新，代价只和变更的文件数有关；返回路由表是否变化
+  bool addFile(const std::string &filePath);
+  bool removeFile(const std::string &filePath);
+  bool applyChanges(const std::vector<std::string> &paths);
+  RouteResultCache::Stats cacheStats() const { return cache_.stats(); }
+  // 预构建的二进制路由清单，格式见 route_manifest.cpp
+  bool writeManifest(const std::string &outPath);
+  bool loadManifest(const std::string &manifestPath);
+  bool loadedFromManifest() const { return loadedFromManifest_; }
+  // 当前路由表中每条路由的计数（matchMany 的批量匹配不计入）
+  std::vector<std::pair<RoutePtr, RouteStats::Snapshot>> routeStats();
 
 private:
-  std::regex compileRoutePattern(const std::string &route,
-                                 std::vector<RouteSegment> &outSegments,
-                                 std::vector<std::string> &outParamNames,
-                                 std::vector<RouteSegmentKind> &outParamKinds,
-                                 bool &outValid);
+  // 读者按线程散列到带 padding 的计数槽，按 epoch 奇偶分两组计数。
+  // 发布新表时翻转 epoch，只需等旧奇偶组排空，新来的读者不会拖住写方。
+  static constexpr size_t kReaderSlots = 64;
+  struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> active[2] = {};
+  };
+  class ReadGuard;
+
+  static bool isPageSource(const std::string &path);
+  static void collectRoutes(const RouteTrieNode &node,
+                            std::vector<RoutePtr> &out);
+  std::vector<RoutePtr> currentRoutes();
+  uint64_t pagesHash() const;
+  static bool parseRoutePattern(const std::string &route,
+                                std::vector<RouteSegment> &outSegments,
+                                std::vector<std::string> &outParamNames,
+                                std::vector<RouteSegmentKind> &outParamKinds);
+  RoutePtr makeRoute(const std::string &route, const std::string &filePath);
+  bool routeForFile(const std::string &filePath, std::string &route,
+                    std::string &normalizedPath) const;
+  bool applyFileChange(RouteTable &table, const std::string &path);
+  static bool insertRoute(RouteTable &table, const RoutePtr &route,
+                          bool inPlace);
+  static bool eraseRoute(RouteTable &table, const Route &key);
+  static const Route *findRoute(const RouteTable &table, std::string_view url,
+                                std::vector<ParamSpan> &spans);
+  const Route *lookupRoute(const RouteTable &table, std::string_view url,
+                           std::vector<ParamSpan> &spans);
+  static bool applyRules(const RouteRuleSet &rules, std::string_view url,
+                         RouteResolution &out);
+  void publish(std::unique_ptr<RouteTable> table);
 
   std::string pagesDir_;
-  std::vector<Route> routes_;
-  std::unordered_map<std::string, Route> routeCache_;
+  std::atomic<const RouteTable *> table_{nullptr};
+  std::mutex writeMutex_; // 串行化 rescan/addRoute，读路径不碰
+  uint32_t generation_ = 0;
+  std::atomic<uint32_t> nextRouteId_{1};
+  std::atomic<uint64_t> epoch_{0};
+  ReaderSlot readers_[kReaderSlots];
+  RouteResultCache cache_;
+  bool loadedFromManifest_ = false;
 };
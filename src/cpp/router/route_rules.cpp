@@ -0,0 +1,260 @@
+#include "route_matcher.hpp"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 规则按 Next.js 的顺序生效：header 规则全部命中的都叠加，redirect 取声明顺序
+// 里第一条，没有 redirect 时再取第一条 rewrite。source 编译成段序列后逐段比较，
+// 不用正则；URL 只切分一次，所有规则共用。
+
+namespace {
+
+// destination / header 值模板：字面文本与参数引用交替
+struct TemplatePart {
+  std::string text;
+  int param = -1; // >= 0 时引用 source 的第 param 个参数
+};
+
+struct CompiledRule {
+  std::vector<RouteSegment> segments;
+  std::vector<std::string> paramNames;
+  std::vector<TemplatePart> destination;
+  int status = 307;
+  std::vector<std::pair<std::string, std::vector<TemplatePart>>> headers;
+};
+
+} // namespace
+
+struct RouteRuleSet {
+  std::vector<CompiledRule> headers;
+  std::vector<CompiledRule> redirects;
+  std::vector<CompiledRule> rewrites;
+};
+
+namespace {
+
+// 识别 [x] / [[x]] / [...x] / [[...x]]，返回引用的参数名
+bool parsePlaceholder(std::string_view text, size_t pos, size_t &end,
+                      std::string_view &name) {
+  const bool optional = text.compare(pos, 2, "[[") == 0;
+  const size_t open = optional ? 2 : 1;
+  const std::string_view close = optional ? "]]" : "]";
+  const size_t closeAt = text.find(close, pos + open);
+  if (closeAt == std::string_view::npos) {
+    return false;
+  }
+  name = text.substr(pos + open, closeAt - pos - open);
+  if (name.compare(0, 3, "...") == 0) {
+    name.remove_prefix(3);
+  }
+  if (name.empty() || name.find_first_of("[]/") != std::string_view::npos) {
+    return false;
+  }
+  end = closeAt + close.size();
+  return true;
+}
+
+bool compileTemplate(const std::string &text,
+                     const std::vector<std::string> &paramNames,
+                     std::vector<TemplatePart> &out, std::string &error) {
+  out.clear();
+  std::string literal;
+  size_t i = 0;
+  while (i < text.size()) {
+    size_t end = 0;
+    std::string_view name;
+    if (text[i] != '[' || !parsePlaceholder(text, i, end, name)) {
+      literal += text[i++];
+      continue;
+    }
+    // 重名参数取最后一个，与页面 params 的覆盖顺序一致
+    int index = -1;
+    for (size_t p = paramNames.size(); p-- > 0;) {
+      if (paramNames[p] == name) {
+        index = static_cast<int>(p);
+        break;
+      }
+    }
+    if (index < 0) {
+      error = "Unknown param [" + std::string(name) + "] in \"" + text + "\"";
+      return false;
+    }
+    if (!literal.empty()) {
+      out.push_back({std::move(literal), -1});
+      literal.clear();
+    }
+    out.push_back({std::string(), index});
+    i = end;
+  }
+  if (!literal.empty()) {
+    out.push_back({std::move(literal), -1});
+  }
+  return true;
+}
+
+// 与前缀树相同的段语义，只是沿一条规则线性比较，不需要回溯
+bool matchSegments(const std::vector<RouteSegment> &segments,
+                   const UrlSegments &u, std::vector<ParamSpan> &spans) {
+  spans.clear();
+  const size_t count = u.segs.size();
+  size_t depth = 0;
+  for (const auto &seg : segments) {
+    if (seg.kind == RouteSegmentKind::OptionalDynamic ||
+        seg.kind == RouteSegmentKind::OptionalCatchAll) {
+      if (depth == count) {
+        spans.push_back(ParamSpan{});
+        return true;
+      }
+    }
+    if (depth == count) {
+      return false;
+    }
+    const uint32_t b = u.segs[depth].first;
+    const uint32_t e = u.segs[depth].second;
+    switch (seg.kind) {
+    case RouteSegmentKind::Static:
+      if (u.url.substr(b, e - b) != seg.text) {
+        return false;
+      }
+      break;
+    case RouteSegmentKind::Dynamic:
+    case RouteSegmentKind::OptionalDynamic:
+      if (e == b ||
+          (seg.kind == RouteSegmentKind::OptionalDynamic && depth + 1 != count)) {
+        return false;
+      }
+      spans.push_back(ParamSpan{b, e, true});
+      break;
+    default: {
+      const std::string_view rest = u.url.substr(b);
+      if (rest.empty() || rest.find_first_of("\r\n") != std::string_view::npos) {
+        return false;
+      }
+      spans.push_back(
+          ParamSpan{b, static_cast<uint32_t>(u.url.size()), true});
+      return true;
+    }
+    }
+    depth++;
+  }
+  return depth == count;
+}
+
+void expand(const std::vector<TemplatePart> &parts, std::string_view url,
+            const std::vector<ParamSpan> &spans, std::string &out) {
+  out.clear();
+  for (const auto &part : parts) {
+    if (part.param < 0) {
+      out += part.text;
+    } else if (spans[part.param].matched) {
+      const ParamSpan &s = spans[part.param];
+      out.append(url.data() + s.begin, s.end - s.begin);
+    }
+  }
+}
+
+} // namespace
+
+bool RouteMatcher::setRules(const std::vector<RouteRule> &rules,
+                            std::string &error) {
+  auto set = std::make_shared<RouteRuleSet>();
+  for (const auto &rule : rules) {
+    CompiledRule c;
+    std::vector<RouteSegmentKind> kinds;
+    if (!parseRoutePattern(rule.source, c.segments, c.paramNames, kinds)) {
+      error = "Invalid rule source \"" + rule.source + "\"";
+      return false;
+    }
+    switch (rule.kind) {
+    case RouteRuleKind::Redirect:
+      if (rule.status != 301 && rule.status != 302 && rule.status != 303 &&
+          rule.status != 307 && rule.status != 308) {
+        error = "Invalid redirect status for \"" + rule.source + "\"";
+        return false;
+      }
+      c.status = rule.status;
+      if (!compileTemplate(rule.destination, c.paramNames, c.destination,
+                           error)) {
+        return false;
+      }
+      set->redirects.push_back(std::move(c));
+      break;
+    case RouteRuleKind::Rewrite:
+      // 只支持改写到站内路径，页面匹配用改写后的路径
+      if (rule.destination.empty() || rule.destination[0] != '/' ||
+          rule.destination.find('?') != std::string::npos) {
+        error = "Rewrite destination must be a path: \"" + rule.destination +
+                "\"";
+        return false;
+      }
+      if (!compileTemplate(rule.destination, c.paramNames, c.destination,
+                           error)) {
+        return false;
+      }
+      set->rewrites.push_back(std::move(c));
+      break;
+    case RouteRuleKind::Header:
+      for (const auto &kv : rule.headers) {
+        if (kv.first.empty()) {
+          error = "Empty header name in rule \"" + rule.source + "\"";
+          return false;
+        }
+        std::vector<TemplatePart> value;
+        if (!compileTemplate(kv.second, c.paramNames, value, error)) {
+          return false;
+        }
+        c.headers.emplace_back(kv.first, std::move(value));
+      }
+      set->headers.push_back(std::move(c));
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  auto next =
+      std::make_unique<RouteTable>(*table_.load(std::memory_order_acquire));
+  if (set->headers.empty() && set->redirects.empty() && set->rewrites.empty()) {
+    next->rules.reset();
+  } else {
+    next->rules = std::move(set);
+  }
+  publish(std::move(next));
+  return true;
+}
+
+bool RouteMatcher::applyRules(const RouteRuleSet &rules, std::string_view url,
+                              RouteResolution &out) {
+  UrlSegments u;
+  if (!splitUrl(url, u)) {
+    return false;
+  }
+  bool hit = false;
+  std::vector<ParamSpan> spans;
+  std::string value;
+  for (const auto &rule : rules.headers) {
+    if (matchSegments(rule.segments, u, spans)) {
+      hit = true;
+      for (const auto &h : rule.headers) {
+        expand(h.second, url, spans, value);
+        out.headers.emplace_back(h.first, value);
+      }
+    }
+  }
+  for (const auto &rule : rules.redirects) {
+    if (matchSegments(rule.segments, u, spans)) {
+      out.redirectStatus = rule.status;
+      expand(rule.destination, url, spans, out.location);
+      return true;
+    }
+  }
+  for (const auto &rule : rules.rewrites) {
+    if (matchSegments(rule.segments, u, spans)) {
+      out.rewritten = true;
+      expand(rule.destination, url, spans, out.url);
+      return true;
+    }
+  }
+  return hit;
+}
@@ -1,15 +1,20 @@
 #include <napi.h>
 
-#include "../cpp/cache/lru_cache.hpp"
+#include "../cpp/cache/ssr_cache.hpp"
 #include "../cpp/renderer/react_renderer.hpp"
 #include "../cpp/router/route_matcher.hpp"
 
 #include <uv.h>
 
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace mini_next {
 std::string markdownToHtml(const std::string &markdown);
@@ -26,7 +31,28 @@ public:
     Napi::Function func =
         DefineClass(env, "RouteMatcher",
                     {InstanceMethod("match", &RouteMatcherWrapper::Match),
-                     InstanceMethod("rescan", &RouteMatcherWrapper::Rescan)});
+                     InstanceMethod("rescan", &RouteMatcherWrapper::Rescan),
+                     InstanceMethod("rescanAsync",
+                                    &RouteMatcherWrapper::RescanAsync),
+                     InstanceMethod("addFile", &RouteMatcherWrapper::AddFile),
+                     InstanceMethod("removeFile",
+                                    &RouteMatcherWrapper::RemoveFile),
+                     InstanceMethod("applyChanges",
+                                    &RouteMatcherWrapper::ApplyChanges),
+                     InstanceMethod("cacheStats",
+                                    &RouteMatcherWrapper::CacheStats),
+                     InstanceMethod("writeManifest",
+                                    &RouteMatcherWrapper::WriteManifest),
+                     InstanceMethod("loadedFromManifest",
+                                    &RouteMatcherWrapper::LoadedFromManifest),
+                     InstanceMethod("matchInto", &RouteMatcherWrapper::MatchInto),
+                     InstanceMethod("matchRouteInfo",
+                                    &RouteMatcherWrapper::MatchRouteInfo),
+                     InstanceMethod("matchMany", &RouteMatcherWrapper::MatchMany),
+                     InstanceMethod("setRules", &RouteMatcherWrapper::SetRules),
+                     InstanceMethod("resolveInto",
+                                    &RouteMatcherWrapper::ResolveInto),
+                     InstanceMethod("stats", &RouteMatcherWrapper::Stats)});
 
     constructor = Napi::Persistent(func);
     constructor.SuppressDestruct();
@@ -40,18 +66,491 @@ public:
     if (info.Length() >= 1 && info[0].IsString()) {
       pagesDir = info[0].As<Napi::String>().Utf8Value();
     }
-    matcher_ = std::make_unique<RouteMatcher>(pagesDir);
+    size_t cacheSize = 4096;
+    std::string manifest;
+    if (info.Length() >= 2 && info[1].IsObject()) {
+      Napi::Object opts = info[1].As<Napi::Object>();
+      Napi::Value v = opts.Get("cacheSize");
+      if (v.IsNumber()) {
+        cacheSize = static_cast<size_t>(v.As<Napi::Number>().Int64Value());
+      }
+      Napi::Value m = opts.Get("manifest");
+      if (m.IsString()) {
+        manifest = m.As<Napi::String>().Utf8Value();
+      }
+    }
+    matcher_ = std::make_shared<RouteMatcher>(pagesDir, cacheSize, manifest);
   }
 
 private:
+  // 在 libuv 线程池里扫描目录并发布新路由表，主线程上的 match 不受影响
+  class RescanWorker : public Napi::AsyncWorker {
+  public:
+    RescanWorker(Napi::Env env, std::shared_ptr<RouteMatcher> matcher)
+        : Napi::AsyncWorker(env), matcher_(std::move(matcher)),
+          deferred_(Napi::Promise::Deferred::New(env)) {}
+
+    Napi::Promise GetPromise() const { return deferred_.Promise(); }
+
+  protected:
+    void Execute() override { matcher_->scanFilesystem(); }
+    void OnOK() override { deferred_.Resolve(Env().Undefined()); }
+    void OnError(const Napi::Error &e) override { deferred_.Reject(e.Value()); }
+
+  private:
+    std::shared_ptr<RouteMatcher> matcher_;
+    Napi::Promise::Deferred deferred_;
+  };
+
   static Napi::FunctionReference constructor;
-  std::unique_ptr<RouteMatcher> matcher_;
+  std::shared_ptr<RouteMatcher> matcher_;
+  std::string urlBuf_;
+  std::vector<ParamSpan> spans_;
+  std::vector<uint32_t> utf16Offsets_;
+  RouteResolution resolution_;
+
+  // 直接把 JS 字符串写进复用的缓冲区，不经过 Utf8Value() 的临时 std::string
+  std::string_view ReadUrl(Napi::Env env, Napi::Value value) {
+    if (urlBuf_.size() < 256) {
+      urlBuf_.resize(256);
+    }
+    size_t len = 0;
+    napi_get_value_string_utf8(env, value, &urlBuf_[0], urlBuf_.size(), &len);
+    // 截断时不会写半个多字节字符，留出 4 字节余量判断是否需要重读
+    if (len + 4 >= urlBuf_.size()) {
+      napi_get_value_string_utf8(env, value, nullptr, 0, &len);
+      urlBuf_.resize(len + 1);
+      napi_get_value_string_utf8(env, value, &urlBuf_[0], urlBuf_.size(), &len);
+    }
+    return std::string_view(urlBuf_.data(), len);
+  }
+
+  // spans 是 UTF-8 字节偏移，JS 的 slice 按 UTF-16 下标；纯 ASCII 时两者相同
+  void ToUtf16Offsets(std::string_view url) {
+    ToUtf16Offsets(url, spans_.data(), spans_.size());
+  }
+
+  void ToUtf16Offsets(std::string_view url, ParamSpan *spans, size_t count) {
+    bool ascii = true;
+    for (unsigned char c : url) {
+      if (c >= 0x80) {
+        ascii = false;
+        break;
+      }
+    }
+    if (ascii) {
+      return;
+    }
+    utf16Offsets_.assign(url.size() + 1, 0);
+    uint32_t units = 0;
+    for (size_t i = 0; i < url.size(); i++) {
+      utf16Offsets_[i] = units;
+      const unsigned char c = static_cast<unsigned char>(url[i]);
+      if ((c & 0xc0) != 0x80) {
+        units += c >= 0xf0 ? 2 : 1;
+      }
+    }
+    utf16Offsets_[url.size()] = units;
+    for (size_t i = 0; i < count; i++) {
+      spans[i].begin = utf16Offsets_[spans[i].begin];
+      spans[i].end = utf16Offsets_[spans[i].end];
+    }
+  }
+
+  // out 布局：[参数个数, begin0, end0, begin1, end1, ...]，缺省的可选参数
+  // begin 为 0xffffffff；out 放不下时只写参数个数，由调用方退回 match()
+  static void WriteSpans(const std::vector<ParamSpan> &spans,
+                         Napi::Uint32Array &out) {
+    const size_t n = spans.size();
+    out[0] = static_cast<uint32_t>(n);
+    if (1 + 2 * n > out.ElementLength()) {
+      return;
+    }
+    for (size_t i = 0; i < n; i++) {
+      out[1 + 2 * i] = spans[i].matched ? spans[i].begin : 0xffffffffu;
+      out[2 + 2 * i] = spans[i].end;
+    }
+  }
+
+  static const char *KindName(RouteSegmentKind kind) {
+    switch (kind) {
+    case RouteSegmentKind::OptionalDynamic:
+      return "optional";
+    case RouteSegmentKind::CatchAll:
+      return "catchAll";
+    case RouteSegmentKind::OptionalCatchAll:
+      return "optionalCatchAll";
+    default:
+      return "dynamic";
+    }
+  }
+
+  bool CheckMatchArgs(const Napi::CallbackInfo &info) {
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsTypedArray() ||
+        info[1].As<Napi::TypedArray>().TypedArrayType() != napi_uint32_array ||
+        info[1].As<Napi::TypedArray>().ElementLength() == 0) {
+      Napi::TypeError::New(info.Env(), "Expected url string and Uint32Array")
+          .ThrowAsJavaScriptException();
+      return false;
+    }
+    return true;
+  }
+
+  // 快路径：返回路由 id（0 表示不匹配），参数区间写进调用方复用的 Uint32Array
+  Napi::Value MatchInto(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!CheckMatchArgs(info)) {
+      return env.Undefined();
+    }
+    const std::string_view url = ReadUrl(env, info[0]);
+    const uint32_t id = matcher_->matchSpans(url, spans_);
+    if (id != 0) {
+      ToUtf16Offsets(url);
+      Napi::Uint32Array out = info[1].As<Napi::Uint32Array>();
+      WriteSpans(spans_, out);
+    }
+    return Napi::Number::New(env, id);
+  }
+
+  // 同 MatchInto，另外返回路由描述 { id, filePath, paramNames, paramKinds }，
+  // 供 JS 按 id 缓存；同一 id 的路由内容不会变化
+  Napi::Value MatchRouteInfo(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!CheckMatchArgs(info)) {
+      return env.Undefined();
+    }
+    const std::string_view url = ReadUrl(env, info[0]);
+    RoutePtr route;
+    if (matcher_->matchSpans(url, spans_, &route) == 0) {
+      return env.Null();
+    }
+    ToUtf16Offsets(url);
+    Napi::Uint32Array out = info[1].As<Napi::Uint32Array>();
+    WriteSpans(spans_, out);
+    return RouteDescriptor(env, *route);
+  }
+
+  static Napi::Object RouteDescriptor(Napi::Env env, const Route &route) {
+    Napi::Object desc = Napi::Object::New(env);
+    desc.Set("id", Napi::Number::New(env, route.id));
+    desc.Set("filePath", Napi::String::New(env, route.filePath));
+    Napi::Array names = Napi::Array::New(env, route.paramNames.size());
+    Napi::Array kinds = Napi::Array::New(env, route.paramKinds.size());
+    for (size_t i = 0; i < route.paramNames.size(); i++) {
+      names.Set(static_cast<uint32_t>(i),
+                Napi::String::New(env, route.paramNames[i]));
+      kinds.Set(static_cast<uint32_t>(i),
+                Napi::String::New(env, KindName(route.paramKinds[i])));
+    }
+    desc.Set("paramNames", names);
+    desc.Set("paramKinds", kinds);
+    return desc;
+  }
+
+  // 批量匹配，结果是列式的：
+  //   routeIds[i]      第 i 个 url 的路由 id，0 表示不匹配
+  //   paramOffsets     长度 n+1，第 i 个 url 的参数在 params 中占
+  //                    [paramOffsets[i], paramOffsets[i+1]) 个区间
+  //   params           每个区间两项 begin/end（UTF-16 下标），缺省参数 begin 为 0xffffffff
+  //   routes           本批涉及的路由描述，同 matchRouteInfo
+  Napi::Value MatchMany(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsArray()) {
+      Napi::TypeError::New(env, "Expected array of url strings")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    unsigned threads = 0;
+    if (info.Length() >= 2 && info[1].IsObject()) {
+      Napi::Value v = info[1].As<Napi::Object>().Get("threads");
+      if (v.IsNumber()) {
+        threads = static_cast<unsigned>(v.As<Napi::Number>().Uint32Value());
+      }
+    }
+
+    // 所有 url 拷进一块连续内存，工作线程只读这块内存，不碰 JS 对象
+    Napi::Array arr = info[0].As<Napi::Array>();
+    const uint32_t n = arr.Length();
+    std::string blob;
+    std::vector<size_t> offsets(n + 1, 0);
+    for (uint32_t i = 0; i < n; i++) {
+      Napi::Value v = arr.Get(i);
+      if (v.IsString()) {
+        blob += ReadUrl(env, v);
+      }
+      offsets[i + 1] = blob.size();
+    }
+    std::vector<std::string_view> urls(n);
+    for (uint32_t i = 0; i < n; i++) {
+      urls[i] = std::string_view(blob).substr(offsets[i],
+                                              offsets[i + 1] - offsets[i]);
+    }
+
+    BatchMatchResult result = matcher_->matchMany(urls, threads);
+
+    Napi::Uint32Array routeIds = Napi::Uint32Array::New(env, n);
+    Napi::Uint32Array paramOffsets = Napi::Uint32Array::New(env, n + 1);
+    Napi::Uint32Array params =
+        Napi::Uint32Array::New(env, result.spans.size() * 2);
+    std::memcpy(routeIds.Data(), result.routeIds.data(), n * sizeof(uint32_t));
+    std::memcpy(paramOffsets.Data(), result.spanOffsets.data(),
+                (n + 1) * sizeof(uint32_t));
+    uint32_t *p = params.Data();
+    for (uint32_t i = 0; i < n; i++) {
+      const uint32_t b = result.spanOffsets[i];
+      const uint32_t e = result.spanOffsets[i + 1];
+      if (b != e) {
+        ToUtf16Offsets(urls[i], &result.spans[b], e - b);
+      }
+    }
+    for (const auto &s : result.spans) {
+      *p++ = s.matched ? s.begin : 0xffffffffu;
+      *p++ = s.end;
+    }
+
+    Napi::Array routes = Napi::Array::New(env, result.routes.size());
+    for (size_t i = 0; i < result.routes.size(); i++) {
+      routes.Set(static_cast<uint32_t>(i),
+                 RouteDescriptor(env, *result.routes[i]));
+    }
+
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("routeIds", routeIds);
+    out.Set("paramOffsets", paramOffsets);
+    out.Set("params", params);
+    out.Set("routes", routes);
+    return out;
+  }
+
+  static std::string StringProp(Napi::Object obj, const char *key) {
+    Napi::Value v = obj.Get(key);
+    return v.IsString() ? v.As<Napi::String>().Utf8Value() : std::string();
+  }
+
+  // { redirects: [{ source, destination, permanent, statusCode }],
+  //   rewrites: [{ source, destination }],
+  //   headers: [{ source, headers: [{ key, value }] }] }，与 next.config 的写法一致
+  Napi::Value SetRules(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsObject()) {
+      Napi::TypeError::New(env, "Expected rules object")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    Napi::Object spec = info[0].As<Napi::Object>();
+    std::vector<RouteRule> rules;
+    auto each = [&](const char *key, RouteRuleKind kind) {
+      Napi::Value list = spec.Get(key);
+      if (!list.IsArray()) {
+        return;
+      }
+      Napi::Array arr = list.As<Napi::Array>();
+      for (uint32_t i = 0; i < arr.Length(); i++) {
+        Napi::Value item = arr.Get(i);
+        if (!item.IsObject()) {
+          continue;
+        }
+        Napi::Object o = item.As<Napi::Object>();
+        RouteRule rule;
+        rule.kind = kind;
+        rule.source = StringProp(o, "source");
+        rule.destination = StringProp(o, "destination");
+        if (kind == RouteRuleKind::Redirect) {
+          Napi::Value code = o.Get("statusCode");
+          rule.status = code.IsNumber()
+                            ? code.As<Napi::Number>().Int32Value()
+                            : (o.Get("permanent").ToBoolean().Value() ? 308 : 307);
+        }
+        Napi::Value headers = o.Get("headers");
+        if (kind == RouteRuleKind::Header && headers.IsArray()) {
+          Napi::Array harr = headers.As<Napi::Array>();
+          for (uint32_t h = 0; h < harr.Length(); h++) {
+            Napi::Value hv = harr.Get(h);
+            if (hv.IsObject()) {
+              rule.headers.emplace_back(StringProp(hv.As<Napi::Object>(), "key"),
+                                        StringProp(hv.As<Napi::Object>(), "value"));
+            }
+          }
+        }
+        rules.push_back(std::move(rule));
+      }
+    };
+    each("headers", RouteRuleKind::Header);
+    each("redirects", RouteRuleKind::Redirect);
+    each("rewrites", RouteRuleKind::Rewrite);
+
+    std::string error;
+    if (!matcher_->setRules(rules, error)) {
+      Napi::Error::New(env, error).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    return env.Undefined();
+  }
+
+  // 规则和页面匹配一次完成。没有规则命中时与 matchInto 相同，返回路由 id；
+  // 命中时返回 { routeId, headers: [[key, value]], redirect: { status, location },
+  // urlPath }（urlPath 为 rewrite 后的路径，spans 相对于它）
+  Napi::Value ResolveInto(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!CheckMatchArgs(info)) {
+      return env.Undefined();
+    }
+    const std::string_view url = ReadUrl(env, info[0]);
+    const bool hit = matcher_->resolve(url, resolution_);
+    const std::string_view target =
+        resolution_.rewritten ? std::string_view(resolution_.url) : url;
+    if (resolution_.routeId != 0) {
+      ToUtf16Offsets(target, resolution_.spans.data(), resolution_.spans.size());
+      Napi::Uint32Array out = info[1].As<Napi::Uint32Array>();
+      WriteSpans(resolution_.spans, out);
+    }
+    if (!hit) {
+      return Napi::Number::New(env, resolution_.routeId);
+    }
+
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("routeId", Napi::Number::New(env, resolution_.routeId));
+    Napi::Array headers = Napi::Array::New(env, resolution_.headers.size());
+    for (size_t i = 0; i < resolution_.headers.size(); i++) {
+      Napi::Array kv = Napi::Array::New(env, 2);
+      kv.Set(0u, Napi::String::New(env, resolution_.headers[i].first));
+      kv.Set(1u, Napi::String::New(env, resolution_.headers[i].second));
+      headers.Set(static_cast<uint32_t>(i), kv);
+    }
+    out.Set("headers", headers);
+    if (resolution_.redirectStatus != 0) {
+      Napi::Object redirect = Napi::Object::New(env);
+      redirect.Set("status", Napi::Number::New(env, resolution_.redirectStatus));
+      redirect.Set("location", Napi::String::New(env, resolution_.location));
+      out.Set("redirect", redirect);
+    }
+    if (resolution_.rewritten) {
+      out.Set("urlPath", Napi::String::New(env, resolution_.url));
+    }
+    return out;
+  }
 
   Napi::Value Rescan(const Napi::CallbackInfo &info) {
     matcher_->scanFilesystem();
     return info.Env().Undefined();
   }
 
+  Napi::Value RescanAsync(const Napi::CallbackInfo &info) {
+    auto *worker = new RescanWorker(info.Env(), matcher_);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+  }
+
+  Napi::Value AddFile(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected file path string")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    return Napi::Boolean::New(
+        env, matcher_->addFile(info[0].As<Napi::String>().Utf8Value()));
+  }
+
+  Napi::Value RemoveFile(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected file path string")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    return Napi::Boolean::New(
+        env, matcher_->removeFile(info[0].As<Napi::String>().Utf8Value()));
+  }
+
+  Napi::Value ApplyChanges(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsArray()) {
+      Napi::TypeError::New(env, "Expected array of changed paths")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    Napi::Array arr = info[0].As<Napi::Array>();
+    std::vector<std::string> paths;
+    paths.reserve(arr.Length());
+    for (uint32_t i = 0; i < arr.Length(); i++) {
+      Napi::Value v = arr.Get(i);
+      if (v.IsString()) {
+        paths.push_back(v.As<Napi::String>().Utf8Value());
+      }
+    }
+    return Napi::Boolean::New(env, matcher_->applyChanges(paths));
+  }
+
+  Napi::Value CacheStats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const auto stats = matcher_->cacheStats();
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    out.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    out.Set("capacity",
+            Napi::Number::New(env, static_cast<double>(stats.capacity)));
+    return out;
+  }
+
+  Napi::Value WriteManifest(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected manifest path string")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    return Napi::Boolean::New(
+        env, matcher_->writeManifest(info[0].As<Napi::String>().Utf8Value()));
+  }
+
+  Napi::Value LoadedFromManifest(const Napi::CallbackInfo &info) {
+    return Napi::Boolean::New(info.Env(), matcher_->loadedFromManifest());
+  }
+
+  // { cache: cacheStats(), routes: [{ id, path, filePath, matches, cacheHits,
+  //   avgMatchNs, latency: [{ le, count }] }] }；avgMatchNs 与 latency 来自采样
+  Napi::Value Stats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("cache", CacheStats(info));
+    const auto stats = matcher_->routeStats();
+    Napi::Array routes = Napi::Array::New(env, stats.size());
+    for (size_t i = 0; i < stats.size(); i++) {
+      const Route &route = *stats[i].first;
+      const RouteStats::Snapshot &s = stats[i].second;
+      Napi::Object r = Napi::Object::New(env);
+      r.Set("id", Napi::Number::New(env, route.id));
+      r.Set("path", Napi::String::New(env, route.path));
+      r.Set("filePath", Napi::String::New(env, route.filePath));
+      r.Set("matches", Napi::Number::New(env, static_cast<double>(s.matches)));
+      r.Set("cacheHits",
+            Napi::Number::New(env, static_cast<double>(s.cacheHits)));
+      r.Set("avgMatchNs",
+            Napi::Number::New(env, s.sampled ? static_cast<double>(s.nanos) /
+                                                   static_cast<double>(s.sampled)
+                                             : 0.0));
+      Napi::Array latency = Napi::Array::New(env, RouteStats::kBuckets);
+      for (size_t b = 0; b < RouteStats::kBuckets; b++) {
+        Napi::Object bucket = Napi::Object::New(env);
+        if (b + 1 < RouteStats::kBuckets) {
+          bucket.Set("le", Napi::Number::New(
+                               env, static_cast<double>(RouteStats::kBucketLimits[b])));
+        } else {
+          bucket.Set("le", env.Null());
+        }
+        bucket.Set("count",
+                   Napi::Number::New(env, static_cast<double>(s.buckets[b])));
+        latency.Set(static_cast<uint32_t>(b), bucket);
+      }
+      r.Set("latency", latency);
+      routes.Set(static_cast<uint32_t>(i), r);
+    }
+    out.Set("routes", routes);
+    return out;
+  }
+
   Napi::Value Match(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
     if (info.Length() < 1 || !info[0].IsString()) {
@@ -60,19 +559,24 @@ private:
       return env.Undefined();
     }
 
-    const std::string url = info[0].As<Napi::String>().Utf8Value();
-    const auto result = matcher_->matchRoute(url);
+    const std::string_view url = ReadUrl(env, info[0]);
+    RoutePtr route;
+    const bool matched = matcher_->matchSpans(url, spans_, &route) != 0;
 
     Napi::Object out = Napi::Object::New(env);
-    out.Set("matched", Napi::Boolean::New(env, result.matched));
-    out.Set("filePath", Napi::String::New(env, result.filePath));
+    out.Set("matched", Napi::Boolean::New(env, matched));
+    out.Set("filePath",
+            Napi::String::New(env, matched ? route->filePath : std::string()));
 
+    // 参数直接从 url 的区间建 JS 字符串，不经过中间 map
     Napi::Object params = Napi::Object::New(env);
-    for (const auto &kv : result.params) {
-      if (kv.second.has_value()) {
-        params.Set(kv.first, Napi::String::New(env, kv.second.value()));
-      } else {
-        params.Set(kv.first, env.Undefined());
+    for (size_t i = 0; matched && i < route->paramNames.size(); i++) {
+      const ParamSpan &s = spans_[i];
+      if (s.matched) {
+        params.Set(route->paramNames[i],
+                   Napi::String::New(env, url.data() + s.begin, s.end - s.begin));
+      } else if (route->paramKinds[i] == RouteSegmentKind::OptionalDynamic) {
+        params.Set(route->paramNames[i], env.Undefined());
       }
     }
     out.Set("params", params);
@@ -246,9 +750,17 @@ public:
     Napi::Function func =
         DefineClass(env, "SSRCache",
                     {InstanceMethod("get", &SSRCacheWrapper::Get),
+                     InstanceMethod("lookup", &SSRCacheWrapper::Lookup),
+                     InstanceMethod("has", &SSRCacheWrapper::Has),
                      InstanceMethod("set", &SSRCacheWrapper::Set),
                      InstanceMethod("erase", &SSRCacheWrapper::Erase),
-                     InstanceMethod("clear", &SSRCacheWrapper::Clear)});
+                     InstanceMethod("acquire", &SSRCacheWrapper::Acquire),
+                     InstanceMethod("complete", &SSRCacheWrapper::Complete),
+                     InstanceMethod("fail", &SSRCacheWrapper::Fail),
+                     InstanceMethod("invalidateTag",
+                                    &SSRCacheWrapper::InvalidateTag),
+                     InstanceMethod("clear", &SSRCacheWrapper::Clear),
+                     InstanceMethod("stats", &SSRCacheWrapper::Stats)});
 
     constructor = Napi::Persistent(func);
     constructor.SuppressDestruct();
@@ -260,61 +772,331 @@ public:
       : Napi::ObjectWrap<SSRCacheWrapper>(info) {
     size_t capacity = 256;
     if (info.Length() >= 1 && info[0].IsNumber()) {
-      const auto cap = info[0].As<Napi::Number>().Uint32Value();
-      capacity = cap == 0 ? 1 : static_cast<size_t>(cap);
+      capacity = static_cast<size_t>(info[0].As<Napi::Number>().Uint32Value());
     }
-    cache_ = std::make_unique<ConcurrentLRUCache<std::string, std::string>>(
-        capacity);
+    size_t shards = 16;
+    size_t maxBytes = 0;
+    int64_t leaseTimeoutMs = 30000;
+    bool checkKeys = false;
+    if (info.Length() >= 2 && info[1].IsObject()) {
+      Napi::Object opts = info[1].As<Napi::Object>();
+      Napi::Value v = opts.Get("shards");
+      if (v.IsNumber()) {
+        shards = static_cast<size_t>(v.As<Napi::Number>().Uint32Value());
+      }
+      Napi::Value mb = opts.Get("maxBytes");
+      if (mb.IsNumber() && mb.As<Napi::Number>().DoubleValue() >= 1) {
+        maxBytes = static_cast<size_t>(mb.As<Napi::Number>().DoubleValue());
+      }
+      Napi::Value rt = opts.Get("leaseTimeoutMs");
+      if (rt.IsNumber() && rt.As<Napi::Number>().Int64Value() > 0) {
+        leaseTimeoutMs = rt.As<Napi::Number>().Int64Value();
+      }
+      checkKeys = opts.Get("checkKeys").ToBoolean().Value();
+    }
+    // 只有设置了字节预算时 capacity 才允许为 0（不限条目数）
+    if (capacity == 0 && maxBytes == 0) {
+      capacity = 1;
+    }
+    cache_ = std::make_unique<mini_next::SSRCache>(capacity, shards, maxBytes,
+                                                   leaseTimeoutMs, checkKeys);
   }
 
 private:
   static Napi::FunctionReference constructor;
-  std::unique_ptr<ConcurrentLRUCache<std::string, std::string>> cache_;
+  std::unique_ptr<mini_next::SSRCache> cache_;
+  // 等待同一 key 生成结果的 Promise；只在 JS 线程访问。租约和等待都按摘要
+  // 合并，checkKeys 只校验读出的条目
+  std::unordered_map<mini_next::KeyDigest, std::vector<Napi::Promise::Deferred>,
+                     mini_next::KeyDigestHash>
+      waiters_;
+  std::string partBuf_;
+  std::string keyText_;
+
+  std::string_view ReadPart(Napi::Env env, Napi::Value value) {
+    if (partBuf_.size() < 256) {
+      partBuf_.resize(256);
+    }
+    size_t len = 0;
+    napi_get_value_string_utf8(env, value, &partBuf_[0], partBuf_.size(), &len);
+    if (len + 4 >= partBuf_.size()) {
+      napi_get_value_string_utf8(env, value, nullptr, 0, &len);
+      partBuf_.resize(len + 1);
+      napi_get_value_string_utf8(env, value, &partBuf_[0], partBuf_.size(),
+                                 &len);
+    }
+    return std::string_view(partBuf_.data(), len);
+  }
+
+  // key 可以是字符串，也可以是字符串数组：各分量逐个流入 hash，JS 侧不用先拼成
+  // 一个大字符串，["a"] 与 "a" 是同一个 key。返回的 text 指向内部缓冲区，
+  // 下一次 ReadKey 之前有效。类型不对时抛出 TypeError 并返回 nullopt
+  std::optional<mini_next::SSRCacheKey> ReadKey(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Value value = info.Length() >= 1 ? info[0] : env.Undefined();
+    if (value.IsArray() && value.As<Napi::Array>().Length() == 1) {
+      value = value.As<Napi::Array>().Get(0u);
+    }
+    if (value.IsString()) {
+      return mini_next::SSRCacheKey(ReadPart(env, value));
+    }
+    if (value.IsArray()) {
+      Napi::Array parts = value.As<Napi::Array>();
+      mini_next::KeyHasher hasher;
+      keyText_.clear();
+      for (uint32_t i = 0; i < parts.Length(); i++) {
+        Napi::Value part = parts.Get(i);
+        if (!part.IsString()) {
+          break;
+        }
+        const std::string_view text = ReadPart(env, part);
+        hasher.add(text);
+        // 校验用的完整 key 与 hash 输入同样带长度前缀
+        if (cache_->checkKeys()) {
+          const uint64_t len = text.size();
+          keyText_.append(reinterpret_cast<const char *>(&len), sizeof(len));
+          keyText_.append(text);
+        }
+        if (i + 1 == parts.Length()) {
+          return mini_next::SSRCacheKey(hasher.digest(), keyText_);
+        }
+      }
+    }
+    Napi::TypeError::New(env, "Expected key string or array of strings")
+        .ThrowAsJavaScriptException();
+    return std::nullopt;
+  }
+
+  static mini_next::SSRCacheEntryOptions
+  ReadEntryOptions(const Napi::CallbackInfo &info, size_t index) {
+    mini_next::SSRCacheEntryOptions entry;
+    if (info.Length() <= index || !info[index].IsObject()) {
+      return entry;
+    }
+    Napi::Object opts = info[index].As<Napi::Object>();
+    Napi::Value ttl = opts.Get("ttlMs");
+    if (ttl.IsNumber()) {
+      entry.ttlMs = ttl.As<Napi::Number>().Int64Value();
+    }
+    Napi::Value stale = opts.Get("staleMs");
+    // Infinity 与不传相同
+    if (stale.IsNumber() &&
+        std::isfinite(stale.As<Napi::Number>().DoubleValue())) {
+      entry.staleMs = stale.As<Napi::Number>().Int64Value();
+    }
+    Napi::Value tags = opts.Get("tags");
+    if (tags.IsArray()) {
+      Napi::Array arr = tags.As<Napi::Array>();
+      for (uint32_t i = 0; i < arr.Length(); i++) {
+        Napi::Value t = arr.Get(i);
+        if (t.IsString()) {
+          entry.tags.push_back(t.As<Napi::String>().Utf8Value());
+        }
+      }
+    }
+    return entry;
+  }
 
   Napi::Value Get(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
-    if (info.Length() < 1 || !info[0].IsString()) {
-      Napi::TypeError::New(env, "Expected key string")
-          .ThrowAsJavaScriptException();
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    auto val = cache_->get(*key);
+    if (!val) {
+      return env.Undefined();
+    }
+    return Napi::String::New(env, *val);
+  }
+
+  // 未命中返回 undefined；否则返回 { state, html, revalidate }，
+  // expired 时没有 html。revalidate 为 true 的调用方负责重新生成并 set
+  Napi::Value Lookup(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    const mini_next::SSRCache::Lookup hit = cache_->lookup(*key);
+    if (hit.state == mini_next::SSRCacheState::Miss) {
       return env.Undefined();
     }
-    const std::string key = info[0].As<Napi::String>().Utf8Value();
-    auto val = cache_->get(key);
-    if (!val.has_value()) {
+    Napi::Object out = Napi::Object::New(env);
+    switch (hit.state) {
+    case mini_next::SSRCacheState::Fresh:
+      out.Set("state", "fresh");
+      break;
+    case mini_next::SSRCacheState::Stale:
+      out.Set("state", "stale");
+      break;
+    default:
+      out.Set("state", "expired");
+      break;
+    }
+    if (hit.html) {
+      out.Set("html", Napi::String::New(env, *hit.html));
+    }
+    out.Set("revalidate", Napi::Boolean::New(env, hit.revalidate));
+    return out;
+  }
+
+  Napi::Value Has(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const auto key = ReadKey(info);
+    if (!key) {
       return env.Undefined();
     }
-    return Napi::String::New(env, val.value());
+    return Napi::Boolean::New(env, cache_->contains(*key));
   }
 
+  // set(key, html, { ttlMs, staleMs, tags })：不传 ttlMs 时永不过期，
+  // 不传 staleMs 时过期后一直返回旧值直到重新生成
   Napi::Value Set(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
-    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
-      Napi::TypeError::New(env, "Expected (key: string, value: string)")
+    if (info.Length() < 2 || !info[1].IsString()) {
+      Napi::TypeError::New(env, "Expected (key, value: string)")
           .ThrowAsJavaScriptException();
       return env.Undefined();
     }
-    const std::string key = info[0].As<Napi::String>().Utf8Value();
-    const std::string value = info[1].As<Napi::String>().Utf8Value();
-    cache_->put(key, value);
-    return env.Undefined();
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    return Napi::Boolean::New(
+        env, cache_->set(*key, info[1].As<Napi::String>().Utf8Value(),
+                         ReadEntryOptions(info, 2)));
+  }
+
+  // 未命中时调用：返回租约号（number）表示由调用方生成，之后必须 complete 或
+  // fail；否则返回一个 Promise，随当前持有者 complete 得到 HTML、fail 得到
+  // 同一个错误
+  Napi::Value Acquire(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    const uint64_t token = cache_->acquireLease(*key);
+    if (token != 0) {
+      return Napi::Number::New(env, static_cast<double>(token));
+    }
+    auto deferred = Napi::Promise::Deferred::New(env);
+    waiters_[key->digest].push_back(deferred);
+    return deferred.Promise();
+  }
+
+  // complete(key, token, html, { ttlMs, staleMs, tags })
+  Napi::Value Complete(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 3 || !info[1].IsNumber() || !info[2].IsString()) {
+      Napi::TypeError::New(env, "Expected (key, token: number, html: string)")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    const auto token =
+        static_cast<uint64_t>(info[1].As<Napi::Number>().Int64Value());
+    Napi::String html = info[2].As<Napi::String>();
+    const bool current = cache_->completeLease(*key, token, html.Utf8Value(),
+                                               ReadEntryOptions(info, 3));
+    // 租约被接手后旧持有者的结果同样有效，等待者直接用它
+    auto it = waiters_.find(key->digest);
+    if (it != waiters_.end()) {
+      std::vector<Napi::Promise::Deferred> waiting = std::move(it->second);
+      waiters_.erase(it);
+      for (const auto &d : waiting) {
+        d.Resolve(html);
+      }
+    }
+    return Napi::Boolean::New(env, current);
+  }
+
+  // fail(key, token, error)：只有当前持有者失败才把 error 传给等待者；
+  // 已被接手的旧租约失败时，等待者继续等新的持有者
+  Napi::Value Fail(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[1].IsNumber()) {
+      Napi::TypeError::New(env, "Expected (key, token: number, error)")
+          .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    const auto token =
+        static_cast<uint64_t>(info[1].As<Napi::Number>().Int64Value());
+    const bool current = cache_->failLease(*key, token);
+    if (current) {
+      auto it = waiters_.find(key->digest);
+      if (it != waiters_.end()) {
+        std::vector<Napi::Promise::Deferred> waiting = std::move(it->second);
+        waiters_.erase(it);
+        Napi::Value error =
+            info.Length() >= 3 && !info[2].IsUndefined()
+                ? info[2]
+                : Napi::Error::New(env, "SSR render failed").Value();
+        for (const auto &d : waiting) {
+          d.Reject(error);
+        }
+      }
+    }
+    return Napi::Boolean::New(env, current);
   }
 
   Napi::Value Erase(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const auto key = ReadKey(info);
+    if (!key) {
+      return env.Undefined();
+    }
+    cache_->erase(*key);
+    return env.Undefined();
+  }
+
+  Napi::Value InvalidateTag(const Napi::CallbackInfo &info) {
     Napi::Env env = info.Env();
     if (info.Length() < 1 || !info[0].IsString()) {
-      Napi::TypeError::New(env, "Expected key string")
+      Napi::TypeError::New(env, "Expected tag string")
           .ThrowAsJavaScriptException();
       return env.Undefined();
     }
-    const std::string key = info[0].As<Napi::String>().Utf8Value();
-    cache_->erase(key);
-    return env.Undefined();
+    const size_t removed =
+        cache_->invalidateTag(info[0].As<Napi::String>().Utf8Value());
+    return Napi::Number::New(env, static_cast<double>(removed));
   }
 
   Napi::Value Clear(const Napi::CallbackInfo &info) {
     cache_->clear();
     return info.Env().Undefined();
   }
+
+  Napi::Value Stats(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("entries",
+            Napi::Number::New(env, static_cast<double>(cache_->size())));
+    out.Set("bytes",
+            Napi::Number::New(env, static_cast<double>(cache_->bytes())));
+    out.Set("maxBytes",
+            Napi::Number::New(env, static_cast<double>(cache_->maxBytes())));
+    out.Set("shards",
+            Napi::Number::New(env, static_cast<double>(cache_->shardCount())));
+    out.Set("tags",
+            Napi::Number::New(env, static_cast<double>(cache_->tagCount())));
+    out.Set("leases",
+            Napi::Number::New(env, static_cast<double>(cache_->leaseCount())));
+    if (cache_->checkKeys()) {
+      out.Set("keyCollisions",
+              Napi::Number::New(
+                  env, static_cast<double>(cache_->keyCollisions())));
+    }
+    return out;
+  }
 };
 
 Napi::FunctionReference SSRCacheWrapper::constructor;
@@ -78,6 +78,106 @@ async function main() {
     assert.strictEqual(m5.matched, true);
     assert.strictEqual(m5.filePath, path.join(pagesDir, 'tabs', '[[tab]].js'));
     assert.deepStrictEqual(m5.params, { tab: 'settings' });
+
+    const before = rm.cacheStats();
+    const m3b = rm.match('/user/123');
+    assert.deepStrictEqual(m3b.params, { id: '123' });
+    const after = rm.cacheStats();
+    assert.strictEqual(after.hits, before.hits + 1);
+    assert.ok(after.capacity > 0);
+
+    const stats = rm.stats();
+    const userStats = stats.routes.find((r) => r.path === '/user/[id]');
+    assert.strictEqual(userStats.matches, 2);
+    assert.strictEqual(userStats.cacheHits, 1);
+    assert.strictEqual(userStats.latency.length, 6);
+    assert.strictEqual(stats.cache.hits, after.hits);
+
+    const spans = new Uint32Array(16);
+    const userId = rm.matchInto('/user/123', spans);
+    assert.ok(userId > 0);
+    assert.deepStrictEqual(Array.from(spans.slice(0, 3)), [1, 6, 9]);
+    const info = rm.matchRouteInfo('/user/123', spans);
+    assert.strictEqual(info.id, userId);
+    assert.strictEqual(info.filePath, m3.filePath);
+    assert.deepStrictEqual(info.paramNames, ['id']);
+    assert.strictEqual(rm.matchInto('/x/y', spans), rm.matchRouteInfo('/z', spans).id);
+    assert.strictEqual(rm.matchInto('relative', spans), 0);
+
+    const batchUrls = ['/user/123', 'relative', '/blog', '/x/y'];
+    const batch = rm.matchMany(batchUrls);
+    assert.strictEqual(batch.routeIds.length, batchUrls.length);
+    assert.strictEqual(batch.routeIds[0], userId);
+    assert.strictEqual(batch.routeIds[1], 0);
+    assert.deepStrictEqual(Array.from(batch.paramOffsets), [0, 1, 1, 1, 2]);
+    assert.deepStrictEqual(Array.from(batch.params), [6, 9, 1, 4]);
+    const batchRoutes = new Map(batch.routes.map((r) => [r.id, r]));
+
+    assert.strictEqual(rm.resolveInto('/user/123', spans), userId);
+    rm.setRules({
+      redirects: [{ source: '/old/[...path]', destination: '/new/[...path]', permanent: true }],
+      rewrites: [{ source: '/u/[id]', destination: '/user/[id]' }],
+      headers: [{ source: '/user/[id]', headers: [{ key: 'x-user', value: '[id]' }] }],
+    });
+    const redirected = rm.resolveInto('/old/a/b', spans);
+    assert.deepStrictEqual(redirected.redirect, { status: 308, location: '/new/a/b' });
+    const rewritten = rm.resolveInto('/u/42', spans);
+    assert.strictEqual(rewritten.urlPath, '/user/42');
+    assert.strictEqual(rewritten.routeId, userId);
+    assert.deepStrictEqual(rewritten.headers, []);
+    assert.strictEqual(rewritten.urlPath.slice(spans[1], spans[2]), '42');
+    assert.deepStrictEqual(rm.resolveInto('/user/7', spans).headers, [['x-user', '7']]);
+    assert.strictEqual(rm.resolveInto('/a', spans), rm.matchInto('/a', spans));
+    assert.throws(() => rm.setRules({ rewrites: [{ source: '/x/[id]', destination: '/y/[slug]' }] }));
+    rm.setRules({});
+    assert.strictEqual(batchRoutes.get(batch.routeIds[2]).filePath, m2.filePath);
+    assert.deepStrictEqual(batchRoutes.get(batch.routeIds[3]).paramNames, ['slug']);
+    assert.deepStrictEqual(rm.match('/user/é').params, { id: 'é' });
+    rm.matchInto('/user/é', spans);
+    assert.strictEqual('/user/é'.slice(spans[1], spans[2]), 'é');
+
+    const manifest = path.join(pagesDir, '..', `${path.basename(pagesDir)}-routes.bin`);
+    try {
+      assert.strictEqual(rm.writeManifest(manifest), true);
+      const fromManifest = new native.RouteMatcher(pagesDir, { manifest });
+      assert.strictEqual(fromManifest.loadedFromManifest(), true);
+      assert.deepStrictEqual(fromManifest.match('/blog/a/b'), m2b);
+      assert.deepStrictEqual(fromManifest.match('/user/123'), m3);
+
+      // 篡改段记录：参数名与 path 不一致，或 catch-all 不在最后，都退回扫描
+      const original = fs.readFileSync(manifest);
+      const segmentCount = original.readUInt32LE(24);
+      const segmentsOff = 32 + original.readUInt32LE(12) * 28;
+      const stringsOff = segmentsOff + segmentCount * 12;
+      const segmentAt = (i) => segmentsOff + i * 12;
+      const textOf = (i) => {
+        const off = stringsOff + original.readUInt32LE(segmentAt(i) + 4);
+        return original.toString('utf8', off, off + original.readUInt32LE(segmentAt(i) + 8));
+      };
+      const segs = Array.from({ length: segmentCount }, (_, i) => ({ kind: original.readUInt32LE(segmentAt(i)), text: textOf(i) }));
+      const idSeg = segs.findIndex((sg) => sg.kind === 1 && sg.text === 'id');
+      const userSeg = segs.findIndex((sg, i) => sg.kind === 0 && sg.text === 'user' && segs[i + 1] && segs[i + 1].text === 'id');
+      assert.ok(idSeg >= 0 && userSeg >= 0);
+      const renamed = Buffer.from(original);
+      renamed.write('ix', stringsOff + renamed.readUInt32LE(segmentAt(idSeg) + 4));
+      const misplaced = Buffer.from(original);
+      misplaced.writeUInt32LE(3, segmentAt(userSeg));
+      for (const corrupted of [renamed, misplaced]) {
+        fs.writeFileSync(manifest, corrupted);
+        const fallback = new native.RouteMatcher(pagesDir, { manifest });
+        assert.strictEqual(fallback.loadedFromManifest(), false);
+        assert.deepStrictEqual(fallback.match('/user/123'), m3);
+        assert.deepStrictEqual(fallback.match('/blog/a/b'), m2b);
+      }
+      fs.writeFileSync(manifest, original);
+
+      writeFile(path.join(pagesDir, 'about.js'), 'module.exports = () => null;');
+      const stale = new native.RouteMatcher(pagesDir, { manifest });
+      assert.strictEqual(stale.loadedFromManifest(), false);
+      assert.strictEqual(stale.match('/about').matched, true);
+    } finally {
+      fs.rmSync(manifest, { force: true });
+    }
   });
 
   withTempDir((pagesDir) => {
@@ -104,8 +204,43 @@ async function main() {
     assert.strictEqual(r1.filePath, path.join(pagesDir, 'tabs', '[[tab]].js'));
     assert.ok(Object.prototype.hasOwnProperty.call(r1.params, 'tab'));
     assert.strictEqual(r1.params.tab, undefined);
+
+    const spans = new Uint32Array(4);
+    const info = rm.matchRouteInfo('/tabs', spans);
+    assert.deepStrictEqual(info.paramKinds, ['optional']);
+    assert.deepStrictEqual(Array.from(spans.slice(0, 2)), [1, 0xffffffff]);
   });
 
+  {
+    const pagesDir = fs.mkdtempSync(path.join(os.tmpdir(), 'mini-next-cpp-'));
+    try {
+      writeFile(path.join(pagesDir, 'index.js'), 'module.exports = () => null;');
+      const rm = new native.RouteMatcher(pagesDir);
+      assert.strictEqual(rm.match('/late').matched, false);
+      writeFile(path.join(pagesDir, 'late.js'), 'module.exports = () => null;');
+      const pending = rm.rescanAsync();
+      assert.strictEqual(rm.match('/').matched, true);
+      await pending;
+      assert.strictEqual(rm.match('/late').filePath, path.join(pagesDir, 'late.js'));
+
+      const postFile = path.join(pagesDir, 'posts', '[id].js');
+      writeFile(postFile, 'module.exports = () => null;');
+      assert.strictEqual(rm.addFile(postFile), true);
+      assert.strictEqual(rm.addFile(postFile), false);
+      assert.deepStrictEqual(rm.match('/posts/7').params, { id: '7' });
+      fs.rmSync(path.join(pagesDir, 'late.js'));
+      assert.strictEqual(rm.applyChanges([path.join(pagesDir, 'late.js')]), true);
+      assert.strictEqual(rm.match('/late').matched, false);
+      fs.rmSync(path.join(pagesDir, 'posts'), { recursive: true, force: true });
+      assert.strictEqual(rm.applyChanges([path.join(pagesDir, 'posts')]), true);
+      assert.strictEqual(rm.match('/posts/7').matched, false);
+      assert.strictEqual(rm.removeFile(path.join(pagesDir, 'index.js')), true);
+      assert.strictEqual(rm.match('/').matched, false);
+    } finally {
+      fs.rmSync(pagesDir, { recursive: true, force: true });
+    }
+  }
+
   {
     const c = new native.SSRCache(2);
     assert.strictEqual(c.get('k'), undefined);
@@ -118,6 +253,129 @@ async function main() {
     assert.strictEqual(c.get('a'), undefined);
   }
 
+  {
+    const c = new native.SSRCache(64, { shards: 4 });
+    c.set('hot', 'h');
+    for (let i = 0; i < 1000; i++) {
+      c.set(`k${i}`, 'v');
+      assert.strictEqual(c.get('hot'), 'h');
+    }
+    assert.strictEqual(c.get('k999'), 'v');
+  }
+
+  {
+    // 只按字节淘汰：总字节不超预算，超过单分片预算的条目不缓存
+    const c = new native.SSRCache(0, { shards: 2, maxBytes: 4096 });
+    const small = 'x'.repeat(30);
+    for (let i = 0; i < 500; i++) {
+      c.set(`s${i}`, small);
+      assert.ok(c.stats().bytes <= 4096);
+    }
+    const st = c.stats();
+    assert.strictEqual(st.maxBytes, 4096);
+    assert.ok(st.entries > 50);
+    assert.strictEqual(c.set('huge', 'y'.repeat(5000)), false);
+    assert.strictEqual(c.get('huge'), undefined);
+    c.clear();
+    assert.strictEqual(c.stats().bytes, 0);
+
+    // 只按条目数淘汰时覆盖写也要更新字节数
+    const counted = new native.SSRCache(8, { shards: 1 });
+    counted.set('k', 'a'.repeat(10));
+    const before = counted.stats().bytes;
+    counted.set('k', 'b'.repeat(100 * 1024));
+    assert.strictEqual(counted.stats().bytes, before + 100 * 1024 - 10);
+    counted.set('k', 'c');
+    assert.strictEqual(counted.stats().bytes, before - 9);
+  }
+
+  {
+    // ttl 过后进入 stale：仍返回旧值，只有第一个调用方拿到重新生成的租约
+    const c = new native.SSRCache(8);
+    c.set('p', 'old', { ttlMs: 20, staleMs: 200 });
+    assert.deepStrictEqual(c.lookup('p'), { state: 'fresh', html: 'old', revalidate: false });
+    assert.strictEqual(c.lookup('missing'), undefined);
+    await new Promise((r) => setTimeout(r, 40));
+    const a = c.lookup('p');
+    const b = c.lookup('p');
+    assert.strictEqual(a.state, 'stale');
+    assert.strictEqual(a.html, 'old');
+    assert.strictEqual(a.revalidate, true);
+    assert.strictEqual(b.revalidate, false);
+    c.set('p', 'new', { ttlMs: 1000 });
+    assert.strictEqual(c.lookup('p').html, 'new');
+    c.set('q', 'q', { ttlMs: 1, staleMs: 0 });
+    await new Promise((r) => setTimeout(r, 10));
+    assert.deepStrictEqual(c.lookup('q'), { state: 'expired', revalidate: false });
+    assert.strictEqual(c.get('q'), undefined);
+  }
+
+  {
+    // 标签索引随淘汰同步收缩，invalidateTag 只删带该标签的条目
+    const c = new native.SSRCache(4, { shards: 1 });
+    c.set('a', '1', { tags: ['m1', 'post:1'] });
+    c.set('b', '2', { tags: ['m1'] });
+    c.set('c', '3', { tags: ['m2'] });
+    assert.strictEqual(c.invalidateTag('post:1'), 1);
+    assert.strictEqual(c.get('a'), undefined);
+    assert.strictEqual(c.get('b'), '2');
+    assert.strictEqual(c.invalidateTag('missing'), 0);
+    for (let i = 0; i < 50; i++) c.set(`x${i}`, 'v', { tags: [`t${i}`] });
+    assert.ok(c.stats().tags <= 4);
+    c.set('d', '4', { tags: ['m3'] });
+    c.set('d', '5');
+    assert.strictEqual(c.invalidateTag('m3'), 0);
+    assert.strictEqual(c.get('d'), '5');
+  }
+
+  {
+    // single-flight：第一个未命中拿租约，其余等待同一个结果或同一个错误
+    const c = new native.SSRCache(8, { leaseTimeoutMs: 30 });
+    const lease = c.acquire('p');
+    assert.strictEqual(typeof lease, 'number');
+    const w1 = c.acquire('p');
+    const w2 = c.acquire('p');
+    assert.ok(w1 instanceof Promise && w2 instanceof Promise);
+    assert.strictEqual(c.complete('p', lease, '<p>', { tags: ['m'] }), true);
+    assert.deepStrictEqual(await Promise.all([w1, w2]), ['<p>', '<p>']);
+    assert.strictEqual(c.get('p'), '<p>');
+
+    const l2 = c.acquire('q');
+    const w3 = c.acquire('q');
+    const boom = new Error('boom');
+    assert.strictEqual(c.fail('q', l2, boom), true);
+    await assert.rejects(w3, (e) => e === boom);
+
+    // 持有者超时后租约可被接手，旧持有者的失败不影响新的等待者
+    const l3 = c.acquire('r');
+    await new Promise((r) => setTimeout(r, 40));
+    const l4 = c.acquire('r');
+    assert.strictEqual(typeof l4, 'number');
+    const w4 = c.acquire('r');
+    assert.strictEqual(c.fail('r', l3, new Error('late')), false);
+    assert.strictEqual(c.complete('r', l4, 'r'), true);
+    assert.strictEqual(await w4, 'r');
+    assert.strictEqual(c.stats().leases, 0);
+  }
+
+  {
+    // key 可按分量传入：逐个流入摘要，分量边界不同的 key 互不命中
+    const c = new native.SSRCache(8, { checkKeys: true });
+    assert.strictEqual(c.set(['/p', '/a', '{}'], 'A'), true);
+    assert.strictEqual(c.get(['/p', '/a', '{}']), 'A');
+    assert.strictEqual(c.get(['/p/', 'a', '{}']), undefined);
+    c.set(['ab', 'c'], 'x');
+    assert.strictEqual(c.get(['a', 'bc']), undefined);
+    c.set('solo', 's');
+    assert.strictEqual(c.get(['solo']), 's');
+    const lease = c.acquire(['/q', '/b']);
+    const waiter = c.acquire(['/q', '/b']);
+    c.complete(['/q', '/b'], lease, 'B');
+    assert.strictEqual(await waiter, 'B');
+    assert.strictEqual(c.stats().keyCollisions, 0);
+    assert.throws(() => c.get(['a', 1]), TypeError);
+  }
+
   {
     const html = native.markdownToHtml('# Hi\n\n- a\n- b\n\n`x` **y**');
     assert.ok(html.includes('<h1>Hi</h1>'));
@@ -216,10 +474,18 @@ async function main() {
           assert.strictEqual(r1.status, 200);
           assert.ok(r1.body.includes('n=1'));
 
+          // 过了 revalidate 先拿到旧页面，后台重新生成后再拿到新页面
           await new Promise((r) => setTimeout(r, 1100));
           const r2 = await get('/');
           assert.strictEqual(r2.status, 200);
-          assert.ok(r2.body.includes('n=2'));
+          assert.ok(r2.body.includes('n=1'));
+          const deadline = Date.now() + 5000;
+          let r3 = await get('/');
+          while (!r3.body.includes('n=2') && Date.now() < deadline) {
+            await new Promise((r) => setTimeout(r, 20));
+            r3 = await get('/');
+          }
+          assert.ok(r3.body.includes('n=2'));
 
           const img1 = await get('/_mini_next/image?url=/a.svg');
           assert.strictEqual(img1.status, 200);
@@ -903,6 +1169,538 @@ async function main() {
     });
   }
 
+  {
+    // mini_next_serve 的条件请求与 Range：内存小文件、常驻 fd 的大文件，以及关闭缓存时按路径打开
+    const http = require('http');
+    const net = require('net');
+    const { spawn } = require('child_process');
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'mini-next-cpp-serve-'));
+    const files = {};
+    for (const [name, size] of [['small.txt', 1000], ['large.bin', 200 * 1024]]) {
+      const buf = Buffer.alloc(size);
+      for (let i = 0; i < size; i++) buf[i] = 32 + (i % 91);
+      writeFile(path.join(dir, name), buf);
+      files[name] = buf;
+    }
+    writeFile(path.join(dir, 'index.html'), '<!doctype html>');
+    // 预压缩的兄弟文件：内容不必是真正的压缩数据，只用来区分选中了哪个版本
+    const appJs = 'console.log(1);\n'.repeat(64);
+    writeFile(path.join(dir, 'app.js'), appJs);
+    writeFile(path.join(dir, 'app.js.br'), 'br-variant');
+    writeFile(path.join(dir, 'app.js.gz'), 'gzip-variant');
+    // 没有 .gz 兄弟文件、足够大的文本文件，--precompress 时在内存中压缩
+    const plainCss = 'body { margin: 0; }\n'.repeat(200);
+    writeFile(path.join(dir, 'plain.css'), plainCss);
+    // /public/ 下带内容哈希的文件名可以永久缓存；根目录下的同名文件不行
+    writeFile(path.join(dir, 'public', 'app.3f9a2b1c.js'), 'hashed');
+    writeFile(path.join(dir, 'public', 'logo.png'), 'png');
+    writeFile(path.join(dir, 'chunk-5KX2A9QZ.js'), 'chunk');
+    // 快照不跟随符号链接目录，这里的文件要靠未命中时查文件系统
+    const linked = fs.mkdtempSync(path.join(os.tmpdir(), 'mini-next-cpp-linked-'));
+    writeFile(path.join(linked, 'a.txt'), 'linked-a');
+    fs.symlinkSync(linked, path.join(dir, 'assets'));
+
+    const freePort = () => new Promise((resolve, reject) => {
+      const s = net.createServer();
+      s.on('error', reject);
+      s.listen(0, '127.0.0.1', () => {
+        const { port } = s.address();
+        s.close(() => resolve(port));
+      });
+    });
+    const request = (port, p, headers = {}) => new Promise((resolve, reject) => {
+      const req = http.request({ hostname: '127.0.0.1', port, path: p, method: 'GET', headers, agent: false }, (r) => {
+        const chunks = [];
+        r.on('data', (c) => chunks.push(c));
+        r.on('end', () => resolve({ status: r.statusCode, headers: r.headers, body: Buffer.concat(chunks) }));
+      });
+      req.on('error', reject);
+      req.end();
+    });
+
+    // 原始 socket 收发：一次写入多个请求（流水线），读到连接关闭为止
+    const rawExchange = (port, chunks, gapMs = 0) => new Promise((resolve, reject) => {
+      const sock = net.connect(port, '127.0.0.1');
+      const out = [];
+      sock.on('data', (c) => out.push(c));
+      sock.on('end', () => resolve(Buffer.concat(out)));
+      sock.on('error', reject);
+      sock.on('connect', async () => {
+        for (const c of [].concat(chunks)) {
+          sock.write(c);
+          if (gapMs) await new Promise((r) => setTimeout(r, gapMs));
+        }
+      });
+    });
+    // 按 content-length 依次切出响应；methods 里 HEAD 对应的应答没有正文
+    const parseResponses = (buf, methods = []) => {
+      const out = [];
+      let off = 0;
+      while (off < buf.length) {
+        const headEnd = buf.indexOf('\r\n\r\n', off);
+        assert.ok(headEnd > 0);
+        const lines = buf.subarray(off, headEnd).toString('latin1').split('\r\n');
+        const headers = {};
+        for (const line of lines.slice(1)) {
+          const i = line.indexOf(':');
+          headers[line.slice(0, i).toLowerCase()] = line.slice(i + 1).trim();
+        }
+        const len = methods[out.length] === 'HEAD' ? 0 : Number(headers['content-length'] || 0);
+        out.push({ status: Number(lines[0].split(' ')[1]), headers, body: buf.subarray(headEnd + 4, headEnd + 4 + len) });
+        off = headEnd + 4 + len;
+      }
+      return out;
+    };
+
+    const serveBin = path.join(__dirname, '..', 'build', 'Release', 'mini_next_serve');
+    // maxFiles 通过 shell 的 ulimit 限制打开文件数
+    const startServe = async (args, serveDir = dir, maxFiles = 0) => {
+      const port = await freePort();
+      const argv = ['--dir', serveDir, '--port', String(port), ...args];
+      const child = maxFiles
+        ? spawn('sh', ['-c', `ulimit -n ${maxFiles} && exec "$0" "$@"`, serveBin, ...argv], { stdio: ['ignore', 'pipe', 'ignore'] })
+        : spawn(serveBin, argv, { stdio: ['ignore', 'pipe', 'ignore'] });
+      let output = '';
+      child.stdout.on('data', (c) => (output += c));
+      const exited = new Promise((r) => child.once('exit', (code, signal) => r({ code, signal })));
+      let dead = false;
+      exited.then(() => (dead = true));
+      const deadline = Date.now() + 10000;
+      for (;;) {
+        try {
+          await request(port, '/index.html');
+          break;
+        } catch (err) {
+          if (dead || Date.now() > deadline) throw err;
+          await new Promise((r) => setTimeout(r, 50));
+        }
+      }
+      return {
+        port,
+        child,
+        exited,
+        output: () => output,
+        stop(signal = 'SIGTERM') {
+          if (!dead) child.kill(signal);
+          return exited;
+        },
+      };
+    };
+
+    try {
+      const variants = [
+        [],
+        ['--cache-size', '0'],
+        // io_uring 不可用的环境里这两项走的是 epoll 回退
+        ['--io-engine', 'io_uring'],
+        ['--io-engine', 'io_uring', '--cache-size', '0'],
+      ];
+      for (const extraArgs of variants) {
+        const server = await startServe(extraArgs);
+        const { port } = server;
+        try {
+          assert.ok(/io engine: (io_uring|epoll)/.test(server.output()));
+
+          for (const [name, data] of Object.entries(files)) {
+            const url = `/${name}`;
+            const len = data.length;
+            const full = await request(port, url);
+            assert.strictEqual(full.status, 200);
+            assert.ok(full.body.equals(data));
+            assert.strictEqual(full.headers['accept-ranges'], 'bytes');
+            const { etag } = full.headers;
+            const lastModified = full.headers['last-modified'];
+            assert.ok(etag && lastModified);
+
+            // If-None-Match 弱比较，且优先于 If-Modified-Since
+            const nm = await request(port, url, { 'if-none-match': `"x", W/${etag}` });
+            assert.strictEqual(nm.status, 304);
+            assert.strictEqual(nm.body.length, 0);
+            assert.strictEqual(nm.headers.etag, etag);
+            assert.strictEqual((await request(port, url, { 'if-modified-since': lastModified })).status, 304);
+            const changed = await request(port, url, { 'if-none-match': '"other"', 'if-modified-since': lastModified });
+            assert.strictEqual(changed.status, 200);
+            assert.ok(changed.body.equals(data));
+
+            const one = await request(port, url, { range: 'bytes=10-19' });
+            assert.strictEqual(one.status, 206);
+            assert.strictEqual(one.headers['content-range'], `bytes 10-19/${len}`);
+            assert.ok(one.body.equals(data.subarray(10, 20)));
+            const suffix = await request(port, url, { range: 'bytes=-5' });
+            assert.strictEqual(suffix.headers['content-range'], `bytes ${len - 5}-${len - 1}/${len}`);
+            assert.ok(suffix.body.equals(data.subarray(len - 5)));
+            const open = await request(port, url, { range: `bytes=${len - 3}-` });
+            assert.ok(open.body.equals(data.subarray(len - 3)));
+
+            // 多个区间：乱序、重叠的区间先排序合并
+            const multi = await request(port, url, { range: 'bytes=50-59, 0-4, 3-7' });
+            assert.strictEqual(multi.status, 206);
+            const m = /^multipart\/byteranges; boundary=(\S+)$/.exec(multi.headers['content-type']);
+            assert.ok(m);
+            const b = m[1];
+            const ct = full.headers['content-type'];
+            const expected = Buffer.concat([
+              Buffer.from(`--${b}\r\ncontent-type: ${ct}\r\ncontent-range: bytes 0-7/${len}\r\n\r\n`),
+              data.subarray(0, 8),
+              Buffer.from(`\r\n--${b}\r\ncontent-type: ${ct}\r\ncontent-range: bytes 50-59/${len}\r\n\r\n`),
+              data.subarray(50, 60),
+              Buffer.from(`\r\n--${b}--\r\n`),
+            ]);
+            assert.ok(multi.body.equals(expected));
+            assert.strictEqual(Number(multi.headers['content-length']), expected.length);
+
+            const bad = await request(port, url, { range: `bytes=${len}-` });
+            assert.strictEqual(bad.status, 416);
+            assert.strictEqual(bad.headers['content-range'], `bytes */${len}`);
+            // 语法错误的 Range 忽略，返回整个文件
+            assert.strictEqual((await request(port, url, { range: 'bytes=5-1' })).status, 200);
+
+            // If-Range：强 ETag 或相同的日期才按区间返回，否则整个文件
+            assert.strictEqual((await request(port, url, { range: 'bytes=0-1', 'if-range': etag })).status, 206);
+            assert.strictEqual((await request(port, url, { range: 'bytes=0-1', 'if-range': lastModified })).status, 206);
+            const stale = await request(port, url, { range: 'bytes=0-1', 'if-range': '"stale"' });
+            assert.strictEqual(stale.status, 200);
+            assert.ok(stale.body.equals(data));
+            assert.strictEqual((await request(port, url, { range: 'bytes=0-1', 'if-range': `W/${etag}` })).status, 200);
+          }
+
+          // Accept-Encoding 协商：br 优先于 gzip，q=0 表示拒绝；有压缩版本的资源总带 vary
+          const negotiated = [
+            [undefined, 'identity'],
+            ['gzip, br', 'br'],
+            ['gzip', 'gzip'],
+            ['br;q=0, gzip', 'gzip'],
+            ['BR;Q=0.5', 'br'],
+            ['*', 'br'],
+            ['*;q=0', 'identity'],
+            ['gzip;q=0, br;q=0.0', 'identity'],
+          ];
+          const bodies = { identity: appJs, br: 'br-variant', gzip: 'gzip-variant' };
+          const etags = new Set();
+          for (const [ae, coding] of negotiated) {
+            const r = await request(port, '/app.js', ae === undefined ? {} : { 'accept-encoding': ae });
+            assert.strictEqual(r.status, 200, `${ae}`);
+            assert.strictEqual(r.body.toString(), bodies[coding], `${ae}`);
+            assert.strictEqual(r.headers['content-encoding'], coding === 'identity' ? undefined : coding, `${ae}`);
+            assert.strictEqual(r.headers.vary, 'accept-encoding');
+            assert.ok(r.headers['content-type'].includes('javascript'));
+            etags.add(r.headers.etag);
+          }
+          // 各编码版本的 ETag 不同，304 只对同一版本成立
+          assert.strictEqual(etags.size, 3);
+          const brR = await request(port, '/app.js', { 'accept-encoding': 'br' });
+          assert.strictEqual((await request(port, '/app.js', { 'accept-encoding': 'br', 'if-none-match': brR.headers.etag })).status, 304);
+          assert.strictEqual((await request(port, '/app.js', { 'accept-encoding': 'gzip', 'if-none-match': brR.headers.etag })).status, 200);
+          // 不可压缩的类型不协商，也不带 vary
+          const bin = await request(port, '/large.bin', { 'accept-encoding': 'gzip, br' });
+          assert.strictEqual(bin.headers['content-encoding'], undefined);
+          assert.strictEqual(bin.headers.vary, undefined);
+
+          // 默认 Cache-Control：HTML（含 SPA 回退）重新验证，/public/ 下的哈希文件名 immutable
+          const immutable = 'public, max-age=31536000, immutable';
+          const hour = 'public, max-age=3600';
+          for (const [url, cc] of [
+            ['/', 'no-cache'],
+            ['/index.html', 'no-cache'],
+            ['/some/route', 'no-cache'],
+            ['/public/app.3f9a2b1c.js', immutable],
+            ['/public/logo.png', hour],
+            ['/chunk-5KX2A9QZ.js', hour],
+            ['/small.txt', hour],
+          ]) {
+            const r = await request(port, url);
+            assert.strictEqual(r.status, 200, url);
+            assert.strictEqual(r.headers['cache-control'], cc, url);
+            assert.strictEqual((await request(port, url, { 'if-none-match': r.headers.etag })).headers['cache-control'], cc, url);
+          }
+
+          // 同一次写入里的多个请求按顺序应答；大文件分块读取时后面的请求不能插队
+          const pipelined = parseResponses(await rawExchange(port, [
+            'GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n'
+            + 'GET /small.txt HTTP/1.1\r\nHost: x\r\nRange: bytes=0-9\r\n\r\n'
+            + 'HEAD /small.txt HTTP/1.1\r\nHost: x\r\n\r\n'
+            + 'GET /large.bin HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n',
+          ]), ['GET', 'GET', 'HEAD', 'GET']);
+          assert.deepStrictEqual(pipelined.map((r) => r.status), [200, 206, 200, 200]);
+          assert.strictEqual(Number(pipelined[2].headers['content-length']), files['small.txt'].length);
+          assert.ok(pipelined[0].body.equals(files['large.bin']));
+          assert.ok(pipelined[1].body.equals(files['small.txt'].subarray(0, 10)));
+          assert.ok(pipelined[3].body.equals(files['large.bin']));
+
+          // 符号链接目录下的文件，以及启动后才出现、快照里没有的文件，都不能落到 SPA 回退
+          const viaLink = await request(port, '/assets/a.txt');
+          assert.strictEqual(viaLink.status, 200);
+          assert.strictEqual(viaLink.body.toString(), 'linked-a');
+          assert.ok(viaLink.headers['content-type'].startsWith('text/plain'));
+          const later = path.join(linked, `later${extraArgs.length}.txt`);
+          writeFile(later, 'later');
+          const viaLinkLater = await request(port, `/assets/${path.basename(later)}`);
+          assert.strictEqual(viaLinkLater.body.toString(), 'later');
+          const missing = await request(port, '/assets/missing.txt');
+          assert.strictEqual(missing.status, 200);
+          assert.strictEqual(missing.body.toString(), '<!doctype html>');
+        } finally {
+          await server.stop();
+        }
+      }
+
+      // --cache-control 规则按顺序先匹配先用，优先于默认策略，也作用于 SPA 回退
+      for (const extraArgs of [[], ['--cache-size', '0']]) {
+        const server = await startServe([
+          ...extraArgs,
+          '--cache-control', '/public/*=no-store',
+          '--cache-control', '/public/app*=private, max-age=60',
+          '--cache-control', '/*.txt= max-age=5',
+          '--cache-control', '/spa/*=no-store',
+        ]);
+        try {
+          for (const [url, cc] of [
+            ['/public/app.3f9a2b1c.js', 'no-store'],
+            ['/public/logo.png', 'no-store'],
+            ['/small.txt', 'max-age=5'],
+            ['/assets/a.txt', 'max-age=5'],
+            ['/index.html', 'no-cache'],
+            ['/spa/route', 'no-store'],
+            ['/large.bin', 'public, max-age=3600'],
+          ]) {
+            assert.strictEqual((await request(server.port, url)).headers['cache-control'], cc, url);
+          }
+        } finally {
+          await server.stop();
+        }
+      }
+
+      // --precompress：没有 .gz 兄弟文件的文本文件在内存中生成 gzip 版本；磁盘上的兄弟文件优先
+      {
+        const zlib = require('zlib');
+        const server = await startServe(['--precompress']);
+        const { port } = server;
+        try {
+          const gz = await request(port, '/plain.css', { 'accept-encoding': 'gzip' });
+          assert.strictEqual(gz.headers['content-encoding'], 'gzip');
+          assert.strictEqual(gz.headers.vary, 'accept-encoding');
+          assert.ok(gz.body.length < plainCss.length);
+          assert.strictEqual(zlib.gunzipSync(gz.body).toString(), plainCss);
+          const identity = await request(port, '/plain.css');
+          assert.strictEqual(identity.headers['content-encoding'], undefined);
+          assert.strictEqual(identity.headers.vary, 'accept-encoding');
+          assert.strictEqual(identity.body.toString(), plainCss);
+          assert.notStrictEqual(identity.headers.etag, gz.headers.etag);
+          assert.strictEqual((await request(port, '/app.js', { 'accept-encoding': 'gzip' })).body.toString(), 'gzip-variant');
+          // 太小的文件不压缩
+          assert.strictEqual((await request(port, '/index.html', { 'accept-encoding': 'gzip' })).headers['content-encoding'], undefined);
+        } finally {
+          await server.stop();
+        }
+      }
+
+      // 运行中修改、新建、删除文件由 inotify 更新快照；超出预算的文件与超出 fd
+      // 上限的大文件只缓存元数据，每次请求按路径打开
+      {
+        const live = fs.mkdtempSync(path.join(os.tmpdir(), 'mini-next-cpp-live-'));
+        writeFile(path.join(live, 'index.html'), '<!doctype html>');
+        writeFile(path.join(live, 'a.txt'), 'v1');
+        writeFile(path.join(live, 'gone.txt'), 'gone');
+        const over = Buffer.alloc(5 * 1024 * 1024, 'o');
+        writeFile(path.join(live, 'over.bin'), over);
+        const fdFiles = [];
+        for (let i = 0; i < 24; i++) {
+          const buf = Buffer.alloc(100 * 1024, 65 + i);
+          writeFile(path.join(live, 'fd', `f${i}.bin`), buf);
+          fdFiles.push(buf);
+        }
+        // ulimit 64 时缓存最多常驻 16 个 fd
+        const server = await startServe(['--cache-size', '4'], live, 64);
+        const { port } = server;
+        const eventually = async (url, check) => {
+          const deadline = Date.now() + 5000;
+          let r = await request(port, url);
+          while (!check(r) && Date.now() < deadline) {
+            await new Promise((res) => setTimeout(res, 20));
+            r = await request(port, url);
+          }
+          return r;
+        };
+        try {
+          assert.strictEqual((await request(port, '/a.txt')).body.toString(), 'v1');
+          writeFile(path.join(live, 'a.txt'), 'version-2');
+          assert.strictEqual((await eventually('/a.txt', (r) => r.body.toString() === 'version-2')).body.toString(), 'version-2');
+          writeFile(path.join(live, 'b.txt'), 'new');
+          assert.strictEqual((await eventually('/b.txt', (r) => r.body.toString() === 'new')).body.toString(), 'new');
+          fs.rmSync(path.join(live, 'gone.txt'));
+          const gone = await eventually('/gone.txt', (r) => r.body.toString() !== 'gone');
+          assert.strictEqual(gone.body.toString(), '<!doctype html>');
+
+          const overR = await request(port, '/over.bin');
+          assert.ok(overR.body.equals(over));
+          assert.ok(/^"[0-9a-f]+-[0-9a-f]+"$/.test(overR.headers.etag));
+          assert.strictEqual((await request(port, '/over.bin', { 'if-none-match': overR.headers.etag })).status, 304);
+          const ranged = await request(port, '/over.bin', { range: 'bytes=100-199' });
+          assert.strictEqual(ranged.status, 206);
+          assert.ok(ranged.body.equals(over.subarray(100, 200)));
+          for (let i = 0; i < fdFiles.length; i++) {
+            const r = await request(port, `/fd/f${i}.bin`);
+            assert.strictEqual(r.status, 200);
+            assert.ok(r.body.equals(fdFiles[i]));
+          }
+        } finally {
+          await server.stop();
+          fs.rmSync(live, { recursive: true, force: true });
+        }
+      }
+
+      // 增量解析：拆成多次到达的请求、同一缓冲区里的多个请求、超长头部、
+      // Transfer-Encoding、每连接请求数上限与空闲超时
+      for (const engine of ['epoll', 'io_uring']) {
+        const server = await startServe(['--io-engine', engine, '--max-requests', '3', '--keep-alive-timeout', '1']);
+        const { port } = server;
+        try {
+          const split = parseResponses(await rawExchange(port, [
+            'GE', 'T /small.txt HTTP/1.1\r\nHo', 'st: x\r\nConnection: close\r', '\n\r\n',
+          ], 20));
+          assert.strictEqual(split.length, 1);
+          assert.ok(split[0].body.equals(files['small.txt']));
+
+          const req = 'GET /small.txt HTTP/1.1\r\nHost: x\r\n\r\n';
+          const limited = parseResponses(await rawExchange(port, req.repeat(4)));
+          assert.deepStrictEqual(limited.map((r) => r.status), [200, 200, 200]);
+          assert.strictEqual(limited[1].headers.connection, 'keep-alive');
+          assert.strictEqual(limited[2].headers.connection, 'close');
+
+          const big = parseResponses(await rawExchange(port, `GET /small.txt HTTP/1.1\r\nHost: x\r\nX-Big: ${'a'.repeat(9000)}\r\n\r\n`));
+          assert.strictEqual(big[0].status, 431);
+          const chunked = parseResponses(await rawExchange(port, 'GET /small.txt HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n'));
+          assert.strictEqual(chunked.length, 1);
+          assert.strictEqual(chunked[0].status, 400);
+
+          // 空闲的长连接在 keep-alive 超时（1 秒，定时器粒度 1 秒）后由服务端关闭
+          const t0 = Date.now();
+          const idle = parseResponses(await rawExchange(port, req));
+          const waited = Date.now() - t0;
+          assert.strictEqual(idle.length, 1);
+          assert.ok(waited >= 900 && waited < 4000, `idle close after ${waited} ms`);
+        } finally {
+          await server.stop();
+        }
+      }
+
+      // 端口已被占用：单进程与多 worker 模式都直接失败退出，不会悄悄共享端口或反复重启
+      {
+        const server = await startServe([]);
+        try {
+          for (const args of [[], ['--workers', '2']]) {
+            const other = spawn(serveBin, ['--dir', dir, '--port', String(server.port), ...args], { stdio: 'ignore' });
+            const timer = setTimeout(() => other.kill('SIGKILL'), 5000);
+            const [code] = await new Promise((r) => other.once('exit', (...a) => r(a)));
+            clearTimeout(timer);
+            assert.ok(code !== null && code !== 0);
+          }
+          assert.strictEqual((await request(server.port, '/small.txt')).status, 200);
+        } finally {
+          await server.stop();
+        }
+      }
+
+      // --workers：SIGHUP 滚动替换与 worker 崩溃后重启期间请求不失败；
+      // SIGTERM 排空时进行中的下载完整发完
+      {
+        const big = Buffer.alloc(16 * 1024 * 1024, 'w');
+        writeFile(path.join(dir, 'big.bin'), big);
+        const server = await startServe(['--workers', '2']);
+        const { port } = server;
+        const readyPids = () => [...server.output().matchAll(/worker \d+ \(pid (\d+)\) ready/g)].map((m) => Number(m[1]));
+        const alive = (pid) => {
+          try {
+            process.kill(pid, 0);
+            return true;
+          } catch (err) {
+            return false;
+          }
+        };
+        const waitFor = async (cond, what) => {
+          const deadline = Date.now() + 10000;
+          while (!cond()) {
+            assert.ok(Date.now() < deadline, `timed out waiting for ${what}`);
+            await new Promise((r) => setTimeout(r, 20));
+          }
+        };
+        // 几个并发的请求循环，直到 stop() 为止，记录失败
+        const load = () => {
+          let running = true;
+          let ok = 0;
+          const failures = [];
+          const loop = async () => {
+            while (running) {
+              try {
+                const r = await request(port, '/small.txt');
+                if (r.status === 200 && r.body.equals(files['small.txt'])) ok++;
+                else failures.push(`status ${r.status}`);
+              } catch (err) {
+                failures.push(err.code || String(err));
+              }
+            }
+          };
+          const loops = Array.from({ length: 4 }, loop);
+          return async () => {
+            running = false;
+            await Promise.all(loops);
+            return { ok, failures };
+          };
+        };
+        try {
+          await waitFor(() => readyPids().length === 2, 'both workers');
+          const first = readyPids();
+
+          let stopLoad = load();
+          server.child.kill('SIGHUP');
+          await waitFor(() => readyPids().length === 4 && !first.some(alive), 'rolling restart');
+          await new Promise((r) => setTimeout(r, 200));
+          let result = await stopLoad();
+          assert.deepStrictEqual(result.failures, []);
+          assert.ok(result.ok > 0);
+          const second = readyPids().slice(2);
+          assert.ok(second.every(alive));
+
+          stopLoad = load();
+          process.kill(second[0], 'SIGKILL');
+          await waitFor(() => readyPids().length === 5, 'respawned worker');
+          await new Promise((r) => setTimeout(r, 200));
+          result = await stopLoad();
+          // 被杀的 worker 上已接受的连接会断开，之后的请求由另一个 worker 与重启的 worker 接手
+          assert.ok(result.ok > 0);
+          assert.strictEqual((await request(port, '/small.txt')).status, 200);
+
+          // 下载开始后暂停读取，让大部分数据留在服务端，再发 SIGTERM
+          const download = new Promise((resolve, reject) => {
+            const req = http.request({ hostname: '127.0.0.1', port, path: '/big.bin', agent: false }, (r) => {
+              r.pause();
+              const chunks = [];
+              r.on('data', (c) => chunks.push(c));
+              r.on('end', () => resolve(Buffer.concat(chunks)));
+              r.on('error', reject);
+              setTimeout(() => {
+                server.child.kill('SIGTERM');
+                setTimeout(() => r.resume(), 300);
+              }, 100);
+            });
+            req.on('error', reject);
+            req.end();
+          });
+          const body = await download;
+          assert.ok(body.equals(big));
+          const { code } = await server.exited;
+          assert.strictEqual(code, 0);
+        } finally {
+          await server.stop();
+          fs.rmSync(path.join(dir, 'big.bin'));
+        }
+      }
+    } finally {
+      fs.rmSync(dir, { recursive: true, force: true });
+      fs.rmSync(linked, { recursive: true, force: true });
+    }
+  }
+
   console.log('cpp-test OK');
 }
 